@@ -1,33 +1,97 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "./src/parser.h"
+#include "./src/scanner.h"
 #include "./src/ast.h"
 #include "./src/err.h"
 #include "./src/symtable.h"
 #include "./src/sem_analysis.h"
+#include "./src/type_analysis.h"
+#include "./src/code_generator.h"
+#include "./src/ir.h"
 #include "./src/args.h"
+#include "./src/intern.h"
+#include "./src/vm.h"
 
 SymTable *g_global_symtable = NULL;
 
 
+// --run-code: execute an IFJcode25 file as ic25int would
+static int run_code_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        error_exit(99, "Cannot open code file '%s'\n", path);
+
+    size_t len = 0, cap = 4096;
+    char *code = malloc(cap);
+    if (!code)
+        error_exit(99, "Out of memory (code file)\n");
+    size_t n;
+    while ((n = fread(code + len, 1, cap - len, f)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            code = realloc(code, cap);
+            if (!code)
+                error_exit(99, "Out of memory (code file)\n");
+        }
+    }
+    fclose(f);
+
+    int exit_code = vm_run(code, len);
+    free(code);
+    intern_free();
+    return exit_code;
+}
+
 int main(int argc, char* argv[]) {
     Args args = handle_args(argc, argv);
+    if (args.run_code)
+        return run_code_file(args.src_file_path);
 
      g_global_symtable = symtable_create(NULL);
     if (!g_global_symtable)
         error_exit(99, "Out of memory (global symtable)\n");
 
-    scanner_init(args.src_file_path);
+    FILE *src = fopen(args.src_file_path, "r");
+    if (!src)
+        error_exit(99, "Cannot open source file '%s'\n", args.src_file_path);
+    scanner_init(src);
 
     
     ASTNode *root = parser_prog();
-    if(sem_analyze(root));
-    
-    //code_gen(root);
+    sem_analyze(root);
+    type_analyze(root, g_global_symtable);
+
+    int exit_code = 0;
+    if (args.dump_ir) {
+        IRProgram *ir = ir_lower(root);
+        ir_optimize(ir);
+        ir_dump(stdout, ir);
+        ir_program_free(ir);
+    } else {
+        CodeGenOptions opts = { .stack_exprs = args.stack_exprs,
+                                .peephole_stats = args.peephole_stats,
+                                .dispatch = args.dispatch };
+        if (args.run) {
+            size_t len;
+            char *code = code_gen_text(root, &opts, &len);
+            exit_code = vm_run(code, len);
+            free(code);
+        } else {
+            code_gen(root, &opts);
+        }
+    }
+
 
+    ast_arena_release();
+    scanner_free();
+    fclose(src);
 
     symtable_free(g_global_symtable);
     g_global_symtable = NULL;
+    intern_free();
 
-    return 0;
+    return exit_code;
 }
@@ -1,12 +1,38 @@
 #include "args.h"
 #include <stdlib.h>
+#include <string.h>
 
 Args handle_args(int argc, char* argv[]) {
-    Args args;
-    if (argc < 2) {
-        printf("Usage: %s <source_file>\n", argv[0]);
+    Args args = { .src_file_path = NULL, .dump_ir = false, .stack_exprs = false,
+                  .peephole_stats = false, .run = false, .run_code = false,
+                  .dispatch = CG_DISPATCH_AUTO };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump-ir") == 0)
+            args.dump_ir = true;
+        else if (strcmp(argv[i], "--stack-exprs") == 0)
+            args.stack_exprs = true;
+        else if (strcmp(argv[i], "--peephole-stats") == 0)
+            args.peephole_stats = true;
+        else if (strcmp(argv[i], "--run") == 0)
+            args.run = true;
+        else if (strcmp(argv[i], "--run-code") == 0)
+            args.run_code = true;
+        else if (strcmp(argv[i], "--dispatch=auto") == 0)
+            args.dispatch = CG_DISPATCH_AUTO;
+        else if (strcmp(argv[i], "--dispatch=inline") == 0)
+            args.dispatch = CG_DISPATCH_INLINE;
+        else if (strcmp(argv[i], "--dispatch=shared") == 0)
+            args.dispatch = CG_DISPATCH_SHARED;
+        else
+            args.src_file_path = argv[i];  // just points to OS-provided memory no need to free
+    }
+
+    if (!args.src_file_path) {
+        printf("Usage: %s [--dump-ir] [--run] [--stack-exprs] [--peephole-stats]\n"
+               "       [--dispatch=auto|inline|shared] <source_file>\n"
+               "       %s --run-code <ifjcode_file>\n", argv[0], argv[0]);
         exit(1);
     }
-    args.src_file_path = argv[1];  // just points to OS-provided memory no need to free
     return args;
-}
\ No newline at end of file
+}
@@ -1,8 +1,16 @@
 #pragma once
 #include <stdio.h>
+#include <stdbool.h>
+#include "code_generator.h"
 
 typedef struct Args {
     char* src_file_path;
+    bool dump_ir;       // --dump-ir: print the IR listing instead of IFJcode25
+    bool stack_exprs;   // --stack-exprs: expression code on the data stack
+    bool peephole_stats; // --peephole-stats: report what the peephole pass removed
+    bool run;           // --run: execute the program in-process instead of printing it
+    bool run_code;      // --run-code: the source is IFJcode25, execute it in-process
+    CodeGenDispatch dispatch; // --dispatch=auto|inline|shared
 } Args;
 
-Args handle_args(int argc, char* argv[]);
\ No newline at end of file
+Args handle_args(int argc, char* argv[]);
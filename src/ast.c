@@ -2,35 +2,91 @@
 #include "err.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+
+#define AST_ARENA_CHUNK_SIZE 65536
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used;
+    size_t cap;
+    max_align_t data[];
+} ArenaChunk;
+
+static ArenaChunk *arena = NULL;
+static bool arena_active = false;
+
+/* ---------------------------------------------------------
+   Arena
+   --------------------------------------------------------- */
+
+static size_t arena_round(size_t size)
+{
+    return (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+}
+
+static void *arena_alloc(size_t size)
+{
+    size = arena_round(size);
+
+    if (!arena || arena->used + size > arena->cap) {
+        size_t cap = size > AST_ARENA_CHUNK_SIZE ? size : AST_ARENA_CHUNK_SIZE;
+        ArenaChunk *c = malloc(sizeof(ArenaChunk) + cap);
+        if (!c)
+            error_exit(99, "AST: arena malloc failed\n");
+        c->next = arena;
+        c->used = 0;
+        c->cap = cap;
+        arena = c;
+    }
+
+    void *p = (char *)arena->data + arena->used;
+    arena->used += size;
+    return p;
+}
+
+void ast_arena_begin(void)
+{
+    arena_active = true;
+}
+
+void ast_arena_release(void)
+{
+    while (arena) {
+        ArenaChunk *next = arena->next;
+        free(arena);
+        arena = next;
+    }
+    arena_active = false;
+}
+
+/* ---------------------------------------------------------
+   Nodes
+   --------------------------------------------------------- */
 
 ASTNode *ast_new(AST_TYPE type, Token *tok)
 {
-    ASTNode *n = malloc(sizeof(ASTNode));
+    ASTNode *n = arena_active ? arena_alloc(sizeof(ASTNode)) : malloc(sizeof(ASTNode));
     if (!n)
         error_exit(99, "AST: malloc failed\n");
 
     n->type = type;
     n->child_count = 0;
+    n->child_cap = 0;
     n->children = NULL;
     n->token = NULL;
+    n->type_mask = 0;
+    n->needs_dynamic_check = false;
+    n->in_arena = arena_active;
 
     if (tok) {
-        Token *copy = malloc(sizeof(Token));
+        Token *copy = arena_active ? arena_alloc(sizeof(Token)) : malloc(sizeof(Token));
         if (!copy)
             error_exit(99, "AST: malloc token failed\n");
 
+        // lexeme is owned by the scanner's pool and shared, not duplicated
         memcpy(copy, tok, sizeof(Token));
 
-        if (tok->lexeme) {
-            size_t len = strlen(tok->lexeme);
-            copy->lexeme = malloc(len + 1);
-            if (!copy->lexeme)
-                error_exit(99, "AST: malloc lexeme failed\n");
-            memcpy(copy->lexeme, tok->lexeme, len + 1);
-        } else {
-            copy->lexeme = NULL;
-        }
-
         n->token = copy;
     }
 
@@ -39,31 +95,69 @@ ASTNode *ast_new(AST_TYPE type, Token *tok)
 
 void ast_add_child(ASTNode *parent, ASTNode *child)
 {
-    ASTNode **new_arr = realloc(
-        parent->children,
-        sizeof(ASTNode*) * (parent->child_count + 1)
-    );
-    if (!new_arr)
-        error_exit(99, "AST: realloc failed\n");
-
-    parent->children = new_arr;
-    parent->children[parent->child_count] = child;
-    parent->child_count++;
+    if (parent->child_count == parent->child_cap) {
+        int cap = parent->child_cap ? 2 * parent->child_cap : 4;
+        ASTNode **new_arr;
+
+        if (parent->in_arena) {
+            // arena blocks cannot be resized in place, copy into a fresh one
+            new_arr = arena_alloc(sizeof(ASTNode*) * cap);
+            if (parent->child_count)
+                memcpy(new_arr, parent->children, sizeof(ASTNode*) * parent->child_count);
+        } else {
+            new_arr = realloc(parent->children, sizeof(ASTNode*) * cap);
+            if (!new_arr)
+                error_exit(99, "AST: realloc failed\n");
+        }
+
+        parent->children = new_arr;
+        parent->child_cap = cap;
+    }
+
+    parent->children[parent->child_count++] = child;
+}
+
+void ast_shrink_to_fit(ASTNode *n)
+{
+    if (!n || n->child_count == n->child_cap)
+        return;
+
+    if (n->in_arena) {
+        // only the most recent arena block can hand its tail back
+        char *end = (char *)n->children + arena_round(sizeof(ASTNode*) * n->child_cap);
+        if (arena && end == (char *)arena->data + arena->used) {
+            size_t keep = arena_round(sizeof(ASTNode*) * n->child_count);
+            arena->used = (size_t)((char *)n->children - (char *)arena->data) + keep;
+            n->child_cap = n->child_count;
+        }
+        return;
+    }
+
+    if (n->child_count == 0) {
+        free(n->children);
+        n->children = NULL;
+        n->child_cap = 0;
+        return;
+    }
+
+    ASTNode **arr = realloc(n->children, sizeof(ASTNode*) * n->child_count);
+    if (arr) {
+        n->children = arr;
+        n->child_cap = n->child_count;
+    }
 }
 
 void ast_free(ASTNode *n)
 {
-    if (!n) return;
+    // arena nodes go away with ast_arena_release()
+    if (!n || n->in_arena) return;
 
     for (int i = 0; i < n->child_count; i++)
         ast_free(n->children[i]);
 
     free(n->children);
 
-    if (n->token) {
-        free(n->token->lexeme);
-        free(n->token);
-    }
+    free(n->token);
 
     free(n);
-}
\ No newline at end of file
+}
@@ -8,15 +8,11 @@ typedef enum {
     
     AST_PROGRAM,
     AST_PROLOG,
-    AST_PROLOG,
     AST_CLASS,
     AST_FUNCTION_S,
     AST_FUNCTION_DEF,
     AST_FUNCTION_KIND,
     
-    AST_FUNCTION_S,
-    AST_FUNCTION_DEF,
-    AST_FUNCTION_KIND,
     AST_FUNCTION,
     AST_GETTER,
     AST_SETTER,
@@ -24,7 +20,6 @@ typedef enum {
 
     AST_PARAM_LIST,
     AST_ARG_LIST,      // ← pridané
-    AST_ARG_LIST,      // ← pridané
     AST_BLOCK,
     AST_STATEMENTS,
 
@@ -34,13 +29,11 @@ typedef enum {
     AST_RETURN,
     AST_IF,
     AST_ELSE,
-    AST_ELSE,
     AST_WHILE,
 
     AST_EXPR,
     AST_IDENTIFIER,
     AST_GID,           // ← pridané
-    AST_GID,       
     AST_LITERAL,
 
     AST_STRING
@@ -53,13 +46,28 @@ typedef struct ASTNode {
 
     struct ASTNode **children;
     int child_count;
+    int child_cap;               // allocated slots in children
 
     unsigned char type_mask;     
     bool needs_dynamic_check;
+    bool in_arena;               // owned by the AST arena, see below
 } ASTNode;
 
 ASTNode *ast_new(AST_TYPE type, Token *tok);
 void ast_add_child(ASTNode *parent, ASTNode *child);
+// trims children to child_count once a node is complete
+void ast_shrink_to_fit(ASTNode *node);
 void ast_free(ASTNode *node);
 
+/* ---------------------------------------------------------
+   AST arena
+   While the arena is active, nodes, token copies and child
+   arrays are bump-allocated from it and the whole tree is
+   dropped at once by ast_arena_release(). ast_free() is a
+   no-op on arena nodes; nodes created with no active arena
+   are malloc'd and must be freed with ast_free().
+   --------------------------------------------------------- */
+void ast_arena_begin(void);
+void ast_arena_release(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "ast_flat.h"
+#include "err.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Internal Helpers
+   --------------------------------------------------------- */
+
+static void count_nodes(const ASTNode *n, int *nodes, int *tokens)
+{
+    (*nodes)++;
+    if (n->token)
+        (*tokens)++;
+    for (int i = 0; i < n->child_count; i++)
+        count_nodes(n->children[i], nodes, tokens);
+}
+
+static void *flat_alloc(size_t count, size_t size)
+{
+    void *p = malloc(count ? count * size : 1);
+    if (!p)
+        error_exit(99, "AST: flat malloc failed\n");
+    return p;
+}
+
+// writes n and its subtree starting at fa->count, returns n's index
+static FlatId flatten(FlatAST *fa, const ASTNode *n, FlatId parent)
+{
+    FlatId id = fa->count++;
+
+    fa->kind[id] = n->type;
+    fa->parent[id] = parent;
+    fa->first_child[id] = FLAT_NONE;
+    fa->next_sibling[id] = FLAT_NONE;
+    fa->type_mask[id] = n->type_mask;
+    fa->dyn_check[id] = n->needs_dynamic_check;
+
+    if (n->token) {
+        fa->tokens[fa->token_count] = *n->token;
+        fa->tok[id] = fa->token_count++;
+    } else {
+        fa->tok[id] = FLAT_NONE;
+    }
+
+    FlatId prev = FLAT_NONE;
+    for (int i = 0; i < n->child_count; i++) {
+        FlatId c = flatten(fa, n->children[i], id);
+        if (prev == FLAT_NONE)
+            fa->first_child[id] = c;
+        else
+            fa->next_sibling[prev] = c;
+        prev = c;
+    }
+
+    fa->end[id] = fa->count;
+    return id;
+}
+
+static void store_types(const FlatAST *fa, ASTNode *n, FlatId *id)
+{
+    n->type_mask = fa->type_mask[*id];
+    n->needs_dynamic_check = fa->dyn_check[*id];
+    (*id)++;
+    for (int i = 0; i < n->child_count; i++)
+        store_types(fa, n->children[i], id);
+}
+
+/* ---------------------------------------------------------
+   API
+   --------------------------------------------------------- */
+
+FlatAST *ast_flat_build(const ASTNode *root)
+{
+    FlatAST *fa = calloc(1, sizeof(FlatAST));
+    if (!fa)
+        error_exit(99, "AST: flat malloc failed\n");
+    if (!root)
+        return fa;
+
+    int nodes = 0, tokens = 0;
+    count_nodes(root, &nodes, &tokens);
+
+    fa->kind         = flat_alloc(nodes, sizeof(AST_TYPE));
+    fa->tok          = flat_alloc(nodes, sizeof(FlatId));
+    fa->first_child  = flat_alloc(nodes, sizeof(FlatId));
+    fa->next_sibling = flat_alloc(nodes, sizeof(FlatId));
+    fa->parent       = flat_alloc(nodes, sizeof(FlatId));
+    fa->end          = flat_alloc(nodes, sizeof(FlatId));
+    fa->type_mask    = flat_alloc(nodes, sizeof(unsigned char));
+    fa->dyn_check    = flat_alloc(nodes, sizeof(bool));
+    fa->tokens       = flat_alloc(tokens, sizeof(Token));
+
+    flatten(fa, root, FLAT_NONE);
+    return fa;
+}
+
+void ast_flat_free(FlatAST *fa)
+{
+    if (!fa) return;
+
+    free(fa->kind);
+    free(fa->tok);
+    free(fa->first_child);
+    free(fa->next_sibling);
+    free(fa->parent);
+    free(fa->end);
+    free(fa->type_mask);
+    free(fa->dyn_check);
+    free(fa->tokens);
+    free(fa);
+}
+
+void ast_flat_store_types(const FlatAST *fa, ASTNode *root)
+{
+    if (!root || fa->count == 0) return;
+
+    FlatId id = 0;
+    store_types(fa, root, &id);
+}
+
+FlatId ast_flat_child(const FlatAST *fa, FlatId n, int i)
+{
+    FlatId c = fa->first_child[n];
+    while (c != FLAT_NONE && i-- > 0)
+        c = fa->next_sibling[c];
+    return c;
+}
+
+int ast_flat_child_count(const FlatAST *fa, FlatId n)
+{
+    int k = 0;
+    FLAT_FOR_EACH_CHILD(fa, n, c)
+        k++;
+    return k;
+}
@@ -0,0 +1,57 @@
+#ifndef AST_FLAT_H
+#define AST_FLAT_H
+
+#include "ast.h"
+#include <stdint.h>
+
+/* ---------------------------------------------------------
+   Flat AST
+   The pointer tree encoded as parallel arrays, nodes laid out
+   in preorder. Node 0 is the root; a node's subtree occupies
+   the index range [n, end[n]). Links are node indices, with
+   FLAT_NONE marking the absence of a child/sibling/token.
+   --------------------------------------------------------- */
+
+#define FLAT_NONE (-1)
+
+typedef int32_t FlatId;
+
+typedef struct FlatAST {
+    int count;
+
+    AST_TYPE      *kind;
+    FlatId        *tok;            // index into tokens
+    FlatId        *first_child;
+    FlatId        *next_sibling;
+    FlatId        *parent;
+    FlatId        *end;            // one past the last node of the subtree
+    unsigned char *type_mask;
+    bool          *dyn_check;
+
+    Token *tokens;                 // dense token copies, lexemes shared
+    int    token_count;
+} FlatAST;
+
+FlatAST *ast_flat_build(const ASTNode *root);
+void     ast_flat_free(FlatAST *fa);
+
+// copies type_mask/dyn_check back onto the tree `root` was flattened from
+void     ast_flat_store_types(const FlatAST *fa, ASTNode *root);
+
+static inline const Token *ast_flat_token(const FlatAST *fa, FlatId n)
+{
+    return fa->tok[n] == FLAT_NONE ? NULL : &fa->tokens[fa->tok[n]];
+}
+
+// i-th child of n, or FLAT_NONE
+FlatId ast_flat_child(const FlatAST *fa, FlatId n, int i);
+int    ast_flat_child_count(const FlatAST *fa, FlatId n);
+
+#define FLAT_FOR_EACH_CHILD(fa, n, c) \
+    for (FlatId c = (fa)->first_child[n]; c != FLAT_NONE; c = (fa)->next_sibling[c])
+
+// preorder walk of the subtree of n, including n itself
+#define FLAT_FOR_EACH_IN_SUBTREE(fa, n, c) \
+    for (FlatId c = (n); c < (fa)->end[n]; c++)
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "ast.h"
+#include "ast_flat.h"
+#include "symtable.h"
+#include "sem_analysis.h"
+#include "type_analysis.h"
+
+SymTable *g_global_symtable = NULL;
+
+// ------------------------------------------------------------
+// Test infrastructure
+// ------------------------------------------------------------
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                   \
+    do {                                                   \
+        if (!(cond)) {                                     \
+            printf("    FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                           \
+            printf("\n");                                  \
+            failures++;                                    \
+        }                                                  \
+    } while (0)
+
+static ASTNode *parse(const char *src)
+{
+    FILE *f = tmpfile();
+    if (!f) {
+        printf("tmpfile() failed\n");
+        exit(1);
+    }
+    fputs(src, f);
+    rewind(f);
+
+    g_global_symtable = symtable_create(NULL);
+    scanner_init(f);
+    return parser_prog();
+}
+
+// ------------------------------------------------------------
+// Pointer tree vs. flat arrays
+// ------------------------------------------------------------
+
+// checks that the subtree of n was laid out in preorder from *id,
+// with matching kind, token, parent, first-child, next-sibling and end links
+static void check_links(const FlatAST *fa, const ASTNode *n, FlatId parent, FlatId *id)
+{
+    FlatId self = (*id)++;
+
+    CHECK(self < fa->count, "node %d past count %d", self, fa->count);
+    if (self >= fa->count)
+        return;
+
+    CHECK(fa->kind[self] == n->type, "node %d kind %d, tree has %d", self, fa->kind[self], n->type);
+    CHECK(fa->parent[self] == parent, "node %d parent %d, expected %d", self, fa->parent[self], parent);
+
+    const Token *t = ast_flat_token(fa, self);
+    CHECK((t == NULL) == (n->token == NULL), "node %d token presence", self);
+    if (t && n->token)
+        CHECK(t->type == n->token->type && t->lexeme == n->token->lexeme,
+              "node %d token differs", self);
+
+    CHECK(ast_flat_child_count(fa, self) == n->child_count,
+          "node %d has %d children, tree has %d", self, ast_flat_child_count(fa, self), n->child_count);
+
+    if (n->child_count == 0)
+        CHECK(fa->first_child[self] == FLAT_NONE, "leaf %d has a first child", self);
+    else
+        CHECK(fa->first_child[self] == self + 1, "node %d first child %d, expected %d",
+              self, fa->first_child[self], self + 1);
+
+    FlatId prev = FLAT_NONE;
+    for (int i = 0; i < n->child_count; i++) {
+        FlatId c = *id;
+        if (prev != FLAT_NONE)
+            CHECK(fa->next_sibling[prev] == c, "node %d next sibling %d, expected %d",
+                  prev, fa->next_sibling[prev], c);
+        CHECK(ast_flat_child(fa, self, i) == c, "child %d of node %d", i, self);
+        check_links(fa, n->children[i], self, id);
+        prev = c;
+    }
+    if (prev != FLAT_NONE)
+        CHECK(fa->next_sibling[prev] == FLAT_NONE, "last child %d has a next sibling", prev);
+
+    CHECK(fa->end[self] == *id, "node %d end %d, expected %d", self, fa->end[self], *id);
+}
+
+// ------------------------------------------------------------
+// Tests
+// ------------------------------------------------------------
+
+static const char *program =
+    "import \"ifj25\" for Ifj\n"
+    "class Program {\n"
+    "    static main() {\n"
+    "        var a = 1\n"
+    "        var b = 2.5\n"
+    "        var x = a + b * a\n"
+    "        if (a < 2) {\n"
+    "            Ifj.write(x)\n"
+    "        } else {\n"
+    "            Ifj.write(\"s\")\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+static void test_links(ASTNode *root)
+{
+    printf("[links]\n");
+    FlatAST *fa = ast_flat_build(root);
+
+    FlatId id = 0;
+    check_links(fa, root, FLAT_NONE, &id);
+    CHECK(id == fa->count, "tree has %d nodes, flat has %d", id, fa->count);
+    CHECK(fa->end[0] == fa->count, "root subtree ends at %d", fa->end[0]);
+
+    ast_flat_free(fa);
+}
+
+// the statements of main(), reached through the flat links only
+static void test_shape(ASTNode *root)
+{
+    printf("[shape]\n");
+    FlatAST *fa = ast_flat_build(root);
+
+    // PROGRAM → CLASS → FUNCTION_S → FUNCTION_DEF → FUNCTION → BLOCK
+    FlatId cls = ast_flat_child(fa, 0, 1);
+    FlatId def = ast_flat_child(fa, ast_flat_child(fa, cls, 1), 0);
+    FlatId fn = ast_flat_child(fa, def, 1);
+    FlatId body = ast_flat_child(fa, fn, 1);
+    CHECK(fa->kind[cls] == AST_CLASS, "class kind %d", fa->kind[cls]);
+    CHECK(fa->kind[def] == AST_FUNCTION_DEF, "def kind %d", fa->kind[def]);
+    CHECK(fa->kind[fn] == AST_FUNCTION, "function kind %d", fa->kind[fn]);
+    CHECK(fa->kind[body] == AST_BLOCK, "body kind %d", fa->kind[body]);
+
+    const AST_TYPE expect[] = { AST_VAR_DECL, AST_VAR_DECL, AST_VAR_DECL, AST_IF, AST_ELSE };
+    int i = 0;
+    FLAT_FOR_EACH_CHILD(fa, body, st) {
+        CHECK(i < 5 && fa->kind[st] == expect[i], "statement %d kind %d", i, fa->kind[st]);
+        i++;
+    }
+    CHECK(i == 5, "body has %d statements", i);
+
+    // var x = a + b * a: the initializer subtree in preorder
+    FlatId x = ast_flat_child(fa, body, 2);
+    CHECK(strcmp(ast_flat_token(fa, x)->lexeme, "x") == 0, "third declaration is not x");
+
+    const AST_TYPE pre[] = { AST_VAR_DECL, AST_ASSIGN, AST_EXPR, AST_IDENTIFIER,
+                             AST_EXPR, AST_IDENTIFIER, AST_IDENTIFIER };
+    const char *names[] = { "x", NULL, NULL, "a", NULL, "b", "a" };
+    int k = 0;
+    FLAT_FOR_EACH_IN_SUBTREE(fa, x, n) {
+        CHECK(k < 7 && fa->kind[n] == pre[k], "preorder %d kind %d", k, fa->kind[n]);
+        const Token *t = ast_flat_token(fa, n);
+        if (k < 7 && names[k])
+            CHECK(t && strcmp(t->lexeme, names[k]) == 0, "preorder %d name", k);
+        k++;
+    }
+    CHECK(k == 7, "initializer subtree has %d nodes", k);
+
+    FlatId plus = x + 2, mul = x + 4;
+    CHECK(ast_flat_token(fa, plus)->type == TOK_PLUS, "root operator is not +");
+    CHECK(ast_flat_token(fa, mul)->type == TOK_STAR, "nested operator is not *");
+    CHECK(fa->next_sibling[plus + 1] == mul, "b * a is not the right operand of +");
+    CHECK(fa->parent[mul] == plus, "parent of * is %d", fa->parent[mul]);
+
+    ast_flat_free(fa);
+}
+
+// type_analyze() runs on the flat arrays and stores the masks back
+static void test_types(ASTNode *root)
+{
+    printf("[types]\n");
+    sem_analyze(root);
+    type_analyze(root, g_global_symtable);
+
+    ASTNode *body = root->children[1]->children[1]->children[0]->children[1]->children[1];
+    ASTNode *plus = body->children[2]->children[0]->children[0];
+    ASTNode *mul = plus->children[1];
+    ASTNode *cond = body->children[3]->children[0];
+
+    CHECK(plus->type_mask == TYPEMASK_FLOAT, "a + b * a mask %d", plus->type_mask);
+    CHECK(mul->type_mask == TYPEMASK_FLOAT, "b * a mask %d", mul->type_mask);
+    CHECK(plus->children[0]->type_mask == TYPEMASK_INT, "a mask %d", plus->children[0]->type_mask);
+    CHECK(!plus->needs_dynamic_check, "a + b * a needs a dynamic check");
+    CHECK(cond->type_mask == TYPEMASK_BOOL, "a < 2 mask %d", cond->type_mask);
+}
+
+int main(void)
+{
+    ASTNode *root = parse(program);
+
+    test_links(root);
+    test_shape(root);
+    test_types(root);
+
+    printf("ast_flat: %s (%d failed checks)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -1,4 +1,6 @@
 #include "builtin.h"
+#include "intern.h"
+#include "err.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -8,34 +10,48 @@
 // ----------------------------------------------------
 
 static const BuiltinInfo builtin_table[] = {
-    // name            arity  return-type         arg types...
-    { "Ifj.readInt",     0,   TYPEMASK_NUM,       {0} },
-    { "Ifj.readDouble",  0,   TYPEMASK_NUM,     {0} },
-    { "Ifj.readString",  0,   TYPEMASK_STRING,    {0} },
+    // id            name              arity  return-type                         arg types...
+    { BI_READ_STR,   "Ifj.read_str",   0,   TYPEMASK_STRING | TYPEMASK_NULL,    {0} },
+    { BI_READ_NUM,   "Ifj.read_num",   0,   TYPEMASK_NUM | TYPEMASK_NULL,       {0} },
 
-    // Ifj.write is variadic, takes ANY type, returns null
-    { "Ifj.write",      -1,   TYPEMASK_NULL,      { TYPEMASK_ALL } },
+    // write(term) takes any type, returns null
+    { BI_WRITE,      "Ifj.write",      1,   TYPEMASK_NULL,      { TYPEMASK_ALL } },
 
-    // length(string) → int
-    { "Ifj.length",      1,   TYPEMASK_NUM,
-                          { TYPEMASK_STRING } },
+    // floor(Num) → integral Num
+    { BI_FLOOR,      "Ifj.floor",      1,   TYPEMASK_INT,       { TYPEMASK_NUM } },
 
-    // substr(string, int, int) → string
-    { "Ifj.substr",      3,   TYPEMASK_STRING,
-                          { TYPEMASK_STRING, TYPEMASK_NUM, TYPEMASK_NUM } },
+    // str(term) → String
+    { BI_STR,        "Ifj.str",        1,   TYPEMASK_STRING,    { TYPEMASK_ALL } },
 
-    // ord(string, int) → int
-    { "Ifj.ord",         2,   TYPEMASK_NUM,
-                          { TYPEMASK_STRING, TYPEMASK_NUM } },
+    // length(String) → Num
+    { BI_LENGTH,     "Ifj.length",     1,   TYPEMASK_INT,
+                                            { TYPEMASK_STRING } },
 
-    // chr(int) → string
-    { "Ifj.chr",         1,   TYPEMASK_STRING,
-                          { TYPEMASK_NUM } },
+    // substring(String, Num, Num) → String | Null
+    { BI_SUBSTRING,  "Ifj.substring",  3,   TYPEMASK_STRING | TYPEMASK_NULL,
+                                            { TYPEMASK_STRING, TYPEMASK_NUM, TYPEMASK_NUM } },
+
+    // strcmp(String, String) → Num (-1, 0, 1)
+    { BI_STRCMP,     "Ifj.strcmp",     2,   TYPEMASK_INT,
+                                            { TYPEMASK_STRING, TYPEMASK_STRING } },
+
+    // ord(String, Num) → Num
+    { BI_ORD,        "Ifj.ord",        2,   TYPEMASK_INT,
+                                            { TYPEMASK_STRING, TYPEMASK_NUM } },
+
+    // chr(Num) → String
+    { BI_CHR,        "Ifj.chr",        1,   TYPEMASK_STRING,
+                                            { TYPEMASK_NUM } },
 };
 
 static const size_t builtin_count =
     sizeof(builtin_table) / sizeof(builtin_table[0]);
 
+// interned builtin_table[i].name, filled on the first lookup after
+// each intern_free()
+static const char *builtin_names[sizeof(builtin_table) / sizeof(builtin_table[0])];
+static uint32_t    builtin_names_gen;
+
 
 // ----------------------------------------------------
 // Lookup functions
@@ -43,13 +59,19 @@ static const size_t builtin_count =
 
 const BuiltinInfo *builtin_lookup(const char *name, int argc)
 {
+    if (!builtin_names[0] || builtin_names_gen != intern_generation()) {
+        for (size_t i = 0; i < builtin_count; ++i)
+            builtin_names[i] = intern_cstr(builtin_table[i].name);
+        builtin_names_gen = intern_generation();
+    }
+
     for (size_t i = 0; i < builtin_count; ++i) {
         const BuiltinInfo *b = &builtin_table[i];
 
-        if (strcmp(b->name, name) != 0)
+        if (builtin_names[i] != name)
             continue;
 
-        if (b->arity < 0)    // variadic
+        if (b->arity < 0 || argc < 0)    // variadic / name-only lookup
             return b;
         if (b->arity == argc)
             return b;
@@ -78,12 +100,12 @@ bool builtin_valid_arity(const char *name, int argc)
 //
 //  AST_FUNC_NAME
 //      ├── AST_IDENTIFIER ("Ifj")
-//      └── AST_IDENTIFIER ("readInt")
+//      └── AST_IDENTIFIER ("read_num")
 //
-// Output malloc'ed string: "Ifj.readInt"
+// Output interned string: "Ifj.read_num"
 // ----------------------------------------------------
 
-char *builtin_extract_name(ASTNode *funcname)
+const char *builtin_extract_name(ASTNode *funcname)
 {
     if (!funcname || funcname->type != AST_FUNC_NAME ||
         funcname->child_count != 2)
@@ -95,32 +117,22 @@ char *builtin_extract_name(ASTNode *funcname)
     if (!ns->token || !id->token)
         return NULL;
 
-    const char *s1 = ns->token->lexeme;
-    const char *s2 = id->token->lexeme;
-
-    size_t len = strlen(s1) + strlen(s2) + 2;
-    char *out = malloc(len);
-    if (!out) return NULL;
-
-    snprintf(out, len, "%s.%s", s1, s2);
-    return out;
+    return builtin_join_name(ns->token->lexeme, id->token->lexeme);
 }
 
-
-// ----------------------------------------------------
-// Codegen opcode mapping (optional)
-// ----------------------------------------------------
-
-const char *builtin_codegen_opcode(const char *name)
+const char *builtin_join_name(const char *s1, const char *s2)
 {
-    if (!strcmp(name, "Ifj.readInt"))    return "READI";
-    if (!strcmp(name, "Ifj.readDouble")) return "READF";
-    if (!strcmp(name, "Ifj.readString")) return "READS";
-    if (!strcmp(name, "Ifj.write"))      return "WRITE";
-    if (!strcmp(name, "Ifj.length"))     return "STRLEN";
-    if (!strcmp(name, "Ifj.substr"))     return "SUBSTR";
-    if (!strcmp(name, "Ifj.ord"))        return "ORD";
-    if (!strcmp(name, "Ifj.chr"))        return "CHR";
-
-    return NULL;
+    size_t l1 = strlen(s1), l2 = strlen(s2);
+    char *buf = malloc(l1 + l2 + 2);
+    if (!buf)
+        error_exit(99, "Out of memory (builtin name)\n");
+
+    memcpy(buf, s1, l1);
+    buf[l1] = '.';
+    memcpy(buf + l1 + 1, s2, l2);
+
+    // any length: a name no builtin has is reported as undefined
+    const char *name = intern(buf, l1 + l2 + 1);
+    free(buf);
+    return name;
 }
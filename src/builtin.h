@@ -6,16 +6,30 @@
 #include "ast.h"
 #include "symtable.h"
 
+typedef enum {
+    BI_READ_STR,
+    BI_READ_NUM,
+    BI_WRITE,
+    BI_FLOOR,
+    BI_STR,
+    BI_LENGTH,
+    BI_SUBSTRING,
+    BI_STRCMP,
+    BI_ORD,
+    BI_CHR
+} BuiltinId;
+
 // Any builtin can specify a type mask for each argument.
 // For variadic builtins, the 'arg_types' apply to each arg.
 typedef struct {
-    const char *name;            // e.g., "Ifj.readInt"
+    BuiltinId id;
+    const char *name;            // e.g., "Ifj.read_num"
     int  arity;                  // >=0 = fixed,  -1 = variadic
     unsigned ret_type;           // TYPEMASK_*
     unsigned arg_types[4];       // Up to 4 args (IFJ doesn't have more)
 } BuiltinInfo;
 
-// Lookup by combined name + arity
+// Lookup by combined name + arity (`name` must be interned)
 const BuiltinInfo *builtin_lookup(const char *name, int argc);
 
 // Check only name
@@ -24,10 +38,11 @@ bool builtin_exists(const char *name);
 // Check name + arity
 bool builtin_valid_arity(const char *name, int argc);
 
-// Extract "Ifj.xxx" from AST_FUNC_NAME (returns malloc'ed string)
-char *builtin_extract_name(ASTNode *funcname_node);
+// Extract "Ifj.xxx" from AST_FUNC_NAME (returns interned string)
+const char *builtin_extract_name(ASTNode *funcname_node);
+
+// Interned "<ns>.<name>", the key builtin_lookup() expects
+const char *builtin_join_name(const char *ns, const char *name);
 
-// Optional: code generator opcode mapping
-const char *builtin_codegen_opcode(const char *name);
 
 #endif
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtin.h"
+#include "intern.h"
+#include "symtable.h"
+
+// `make unit-test` links every compiler source, which expects main.c's table
+SymTable *g_global_symtable = NULL;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                   \
+    do {                                                   \
+        if (!(cond)) {                                     \
+            printf("    FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                           \
+            printf("\n");                                  \
+            failures++;                                    \
+        }                                                  \
+    } while (0)
+
+// lookups keep working across intern_free(), as for a second compile
+// in the same process
+static void test_cache_reset(void)
+{
+    printf("[cache_reset]\n");
+    for (int round = 0; round < 3; round++) {
+        const BuiltinInfo *b = builtin_lookup(builtin_join_name("Ifj", "write"), 1);
+        CHECK(b && b->id == BI_WRITE, "round %d: Ifj.write not found", round);
+        CHECK(!builtin_lookup(builtin_join_name("Ifj", "write"), 2),
+              "round %d: Ifj.write/2 found", round);
+
+        intern_free();
+        // reuse the freed space with other strings
+        for (int i = 0; i < 100; i++) {
+            char buf[16];
+            snprintf(buf, sizeof buf, "s%d", i);
+            intern_cstr(buf);
+        }
+    }
+    intern_free();
+}
+
+// a name of any length is interned, an unknown one is simply not found
+static void test_long_name(void)
+{
+    printf("[long_name]\n");
+    char id[301];
+    memset(id, 'x', 300);
+    id[300] = '\0';
+
+    const char *name = builtin_join_name("Ifj", id);
+    CHECK(name != NULL, "no name for a 300 character builtin");
+    CHECK(name && intern_len(name) == 304, "name length %zu", name ? intern_len(name) : 0);
+    CHECK(name && !builtin_exists(name), "Ifj.xxx... exists");
+    CHECK(builtin_join_name("Ifj", id) == name, "long name interned twice");
+    intern_free();
+}
+
+int main(void)
+{
+    test_cache_reset();
+    test_long_name();
+
+    printf("builtin: %s (%d failed checks)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -1 +1,1393 @@
-// TODO
\ No newline at end of file
+// code_generator.c
+
+#include "code_generator.h"
+#include "ir.h"
+#include "builtin.h"
+#include "peephole.h"
+#include "err.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+/* ---------------------------------------------------------
+   Output buffer
+   The whole program is built in memory and written out once
+   at the end.
+   --------------------------------------------------------- */
+
+#define CODEBUF_INITIAL_CAP 65536
+
+typedef struct {
+    char  *data;
+    size_t len;
+    size_t cap;
+} CodeBuf;
+
+static CodeBuf out_buf;
+
+static void buf_reserve(CodeBuf *b, size_t extra)
+{
+    if (b->len + extra + 1 <= b->cap)
+        return;
+
+    size_t cap = b->cap ? b->cap : CODEBUF_INITIAL_CAP;
+    while (cap < b->len + extra + 1)
+        cap *= 2;
+
+    char *data = realloc(b->data, cap);
+    if (!data)
+        error_exit(99, "Out of memory (code buffer)\n");
+    b->data = data;
+    b->cap = cap;
+}
+
+static void buf_append(CodeBuf *b, const char *s, size_t n)
+{
+    buf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+static void buf_vprintf(CodeBuf *b, const char *fmt, va_list ap)
+{
+    va_list ap2;
+    va_copy(ap2, ap);
+
+    buf_reserve(b, 128);
+    int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    if (n < 0)
+        error_exit(99, "Internal: code formatting failed\n");
+    if ((size_t)n >= b->cap - b->len) {
+        buf_reserve(b, (size_t)n);
+        vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap2);
+    }
+    b->len += (size_t)n;
+
+    va_end(ap2);
+}
+
+static void buf_free(CodeBuf *b)
+{
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+// one instruction per call, newline added
+static void emit(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    buf_vprintf(&out_buf, fmt, ap);
+    va_end(ap);
+    buf_append(&out_buf, "\n", 1);
+}
+
+/* ---------------------------------------------------------
+   Operand strings
+   Operands ("LF@x$1", "int@5", "string@a\032b") live in a
+   pool that is reset after every function.
+   --------------------------------------------------------- */
+
+#define OPERAND_CHUNK_SIZE 16384
+
+typedef struct OpChunk {
+    struct OpChunk *next;
+    size_t used;
+    size_t cap;
+    _Alignas(void *) char data[];
+} OpChunk;
+
+static OpChunk *operands = NULL;
+
+static char *op_alloc(size_t n)
+{
+    // keep every block pointer-aligned, argument arrays live here too
+    n = (n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    if (!operands || operands->used + n > operands->cap) {
+        size_t cap = n > OPERAND_CHUNK_SIZE ? n : OPERAND_CHUNK_SIZE;
+        OpChunk *c = malloc(sizeof(OpChunk) + cap);
+        if (!c)
+            error_exit(99, "Out of memory (operands)\n");
+        c->next = operands;
+        c->used = 0;
+        c->cap = cap;
+        operands = c;
+    }
+    char *p = operands->data + operands->used;
+    operands->used += n;
+    return p;
+}
+
+static const char *op_fmt(const char *fmt, ...)
+{
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        error_exit(99, "Internal: operand formatting failed\n");
+
+    char *p = op_alloc((size_t)n + 1);
+    vsnprintf(p, (size_t)n + 1, fmt, ap2);
+    va_end(ap2);
+    return p;
+}
+
+static void op_reset(void)
+{
+    while (operands) {
+        OpChunk *next = operands->next;
+        free(operands);
+        operands = next;
+    }
+}
+
+// string@ literal: whitespace, '#', '\\' and control chars as \ddd
+static const char *op_string(const char *s)
+{
+    size_t len = strlen(s);
+    char *p = op_alloc(len * 4 + sizeof("string@"));
+    char *w = p + sprintf(p, "string@");
+
+    for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+        if (*c <= 32 || *c == '#' || *c == '\\')
+            w += sprintf(w, "\\%03u", *c);
+        else
+            *w++ = (char)*c;
+    }
+    *w = '\0';
+    return p;
+}
+
+/* ---------------------------------------------------------
+   Generator state
+   --------------------------------------------------------- */
+
+// scratch registers shared by the inline type dispatch
+#define R_TA "GF@%ta"
+#define R_TB "GF@%tb"
+#define R_X  "GF@%x"
+#define R_Y  "GF@%y"
+#define R_R  "GF@%r"      // result of the $$rt_* helpers
+
+#define ERR_TYPE_LABEL  "$$rt_err26"
+#define ERR_PARAM_LABEL "$$rt_err25"
+
+typedef struct {
+    const IRFunc *fn;       // function being emitted
+    int block_label;        // $$L<n> of the function's block 0
+    int label_count;        // program-wide, for $$L<n>
+    unsigned builtins_used; // bit per BuiltinId with a runtime routine
+    unsigned helpers_used;  // bit per IROp with a $$rt_* helper
+    int helper_sites[IR_RETURN + 1]; // dispatching sites outside loops, per helper
+    CodeGenOptions opts;
+    bool *in_loop;          // per block of fn: part of a loop (dispatch policy)
+    bool *on_stack;         // per IRVar: temp kept on the data stack (stack_exprs)
+    int *slot;              // per IRVar: var whose LF@ variable it shares
+} CodeGen;
+
+static CodeGen cg;
+
+static const char *new_label(void)
+{
+    return op_fmt("$$L%d", cg.label_count++);
+}
+
+static const char *block_label(int block)
+{
+    return op_fmt("$$L%d", cg.block_label + block);
+}
+
+/* ---------------------------------------------------------
+   Operands
+   --------------------------------------------------------- */
+
+static const char *operand(IROperand o)
+{
+    switch (o.kind) {
+        case IR_OPD_VAR: {
+            const IRVar *v = &cg.fn->vars[cg.slot ? cg.slot[o.u.var] : o.u.var];
+            if (v->kind == IR_VAR_PARAM)
+                return op_fmt("LF@%%%d", v->index + 1);
+            if (v->kind == IR_VAR_TEMP)
+                return op_fmt("LF@%%t%d", v->index);
+            return op_fmt("LF@%s$%d", v->name, v->index);
+        }
+        case IR_OPD_GLOBAL: return op_fmt("GF@%s", o.u.name);
+        case IR_OPD_INT:    return op_fmt("int@%lld", o.u.i);
+        case IR_OPD_FLOAT:  return op_fmt("float@%a", o.u.f);
+        case IR_OPD_STRING: return op_string(o.u.name);
+        case IR_OPD_BOOL:   return o.u.b ? "bool@true" : "bool@false";
+        case IR_OPD_NIL:    return "nil@nil";
+        default:
+            break;
+    }
+    error_exit(99, "Internal: missing IR operand\n");
+    return NULL;
+}
+
+// operand text together with the type the analysis proved for it
+typedef struct {
+    const char *s;
+    TypeMask    mask;
+} Val;
+
+static Val value(IROperand o)
+{
+    return (Val){ operand(o), ir_operand_mask(cg.fn, o) };
+}
+
+/* ---------------------------------------------------------
+   Dynamically typed operators
+   Operand types are only known at run time, so each operator
+   inspects them with TYPE and jumps to the matching variant.
+   Incompatible operands end the program with exit code 26.
+   --------------------------------------------------------- */
+
+static void emit_types(const char *a, const char *b)
+{
+    emit("TYPE %s %s", R_TA, a);
+    emit("TYPE %s %s", R_TB, b);
+}
+
+// a, b (types in R_TA/R_TB) → R_X, R_Y both int or both float
+static void emit_num_pair(const char *a, const char *b)
+{
+    const char *same = new_label();
+    const char *a_int = new_label();
+    const char *done = new_label();
+
+    emit("MOVE %s %s", R_X, a);
+    emit("MOVE %s %s", R_Y, b);
+    emit("JUMPIFEQ %s %s %s", same, R_TA, R_TB);
+
+    emit("JUMPIFEQ %s %s string@int", a_int, R_TA);
+    emit("JUMPIFNEQ %s %s string@float", ERR_TYPE_LABEL, R_TA);
+    emit("JUMPIFNEQ %s %s string@int", ERR_TYPE_LABEL, R_TB);
+    emit("INT2FLOAT %s %s", R_Y, R_Y);
+    emit("JUMP %s", done);
+
+    emit("LABEL %s", a_int);
+    emit("JUMPIFNEQ %s %s string@float", ERR_TYPE_LABEL, R_TB);
+    emit("INT2FLOAT %s %s", R_X, R_X);
+    emit("JUMP %s", done);
+
+    emit("LABEL %s", same);
+    emit("JUMPIFEQ %s %s string@int", done, R_TA);
+    emit("JUMPIFNEQ %s %s string@float", ERR_TYPE_LABEL, R_TA);
+
+    emit("LABEL %s", done);
+}
+
+/* ---------------------------------------------------------
+   Statically typed Num operands
+   When the analysis proved each operand to be exactly an int
+   or exactly a float, the conversion is decided here and the
+   instruction is emitted without any TYPE dispatch.
+   --------------------------------------------------------- */
+
+static bool is_exact_num(TypeMask m)
+{
+    return m == TYPEMASK_INT || m == TYPEMASK_FLOAT;
+}
+
+// int operand as a float: int@ constants are rewritten, others go through `reg`
+static const char *static_int2float(const char *s, const char *reg)
+{
+    if (strncmp(s, "int@", 4) == 0)
+        return op_fmt("float@%a", (double)strtoll(s + 4, NULL, 10));
+
+    emit("INT2FLOAT %s %s", reg, s);
+    return reg;
+}
+
+// a, b → both int or both float (float when `want_float`); false if not proven
+static bool static_num_pair(Val *a, Val *b, bool want_float)
+{
+    if (!is_exact_num(a->mask) || !is_exact_num(b->mask))
+        return false;
+
+    bool to_float = want_float || a->mask == TYPEMASK_FLOAT || b->mask == TYPEMASK_FLOAT;
+    if (to_float && a->mask == TYPEMASK_INT)
+        a->s = static_int2float(a->s, R_X);
+    if (to_float && b->mask == TYPEMASK_INT)
+        b->s = static_int2float(b->s, R_Y);
+    return true;
+}
+
+// String * Num: `a` repeated R_Y times
+static void emit_repeat(const char *dst, const char *a, Val b)
+{
+    const char *count_ok = new_label();
+    const char *loop = new_label();
+    const char *end = new_label();
+
+    emit("MOVE %s %s", R_Y, b.s);
+    if (b.mask != TYPEMASK_INT) {
+        emit("JUMPIFEQ %s %s string@int", count_ok, R_TB);
+        emit("JUMPIFNEQ %s %s string@float", ERR_TYPE_LABEL, R_TB);
+        emit("ISINT %s %s", R_TB, b.s);
+        emit("JUMPIFNEQ %s %s bool@true", ERR_TYPE_LABEL, R_TB);
+        emit("FLOAT2INT %s %s", R_Y, b.s);
+    }
+    emit("LABEL %s", count_ok);
+    emit("LT %s %s int@0", R_TB, R_Y);
+    emit("JUMPIFEQ %s %s bool@true", ERR_TYPE_LABEL, R_TB);
+
+    emit("MOVE %s string@", dst);
+    emit("LABEL %s", loop);
+    emit("JUMPIFEQ %s %s int@0", end, R_Y);
+    emit("CONCAT %s %s %s", dst, dst, a);
+    emit("SUB %s %s int@1", R_Y, R_Y);
+    emit("JUMP %s", loop);
+    emit("LABEL %s", end);
+}
+
+static void emit_arith(IROp op, const char *dst, Val a, Val b)
+{
+    // String + String needs nothing but the concatenation
+    if (op == IR_ADD && a.mask == TYPEMASK_STRING && b.mask == TYPEMASK_STRING) {
+        emit("CONCAT %s %s %s", dst, a.s, b.s);
+        return;
+    }
+
+    if (static_num_pair(&a, &b, op == IR_DIV)) {
+        static const char *mnemonic[] = {
+            [IR_ADD] = "ADD", [IR_SUB] = "SUB", [IR_MUL] = "MUL", [IR_DIV] = "DIV"
+        };
+        emit("%s %s %s %s", mnemonic[op], dst, a.s, b.s);
+        return;
+    }
+
+    bool strings = (op == IR_ADD || op == IR_MUL) && (a.mask & TYPEMASK_STRING);
+    const char *numeric = NULL;
+    const char *end = NULL;
+
+    emit_types(a.s, b.s);
+
+    if (strings) {
+        // left operand may be a String: concatenation / repetition
+        if (a.mask != TYPEMASK_STRING) {
+            numeric = new_label();
+            end = new_label();
+            emit("JUMPIFNEQ %s %s string@string", numeric, R_TA);
+        }
+        if (op == IR_ADD) {
+            emit("JUMPIFNEQ %s %s string@string", ERR_TYPE_LABEL, R_TB);
+            emit("CONCAT %s %s %s", dst, a.s, b.s);
+        } else {
+            emit_repeat(dst, a.s, b);
+        }
+        if (!numeric)
+            return;
+        emit("JUMP %s", end);
+        emit("LABEL %s", numeric);
+    }
+
+    emit_num_pair(a.s, b.s);
+
+    switch (op) {
+        case IR_ADD: emit("ADD %s %s %s", dst, R_X, R_Y); break;
+        case IR_SUB: emit("SUB %s %s %s", dst, R_X, R_Y); break;
+        case IR_MUL: emit("MUL %s %s %s", dst, R_X, R_Y); break;
+        case IR_DIV: {
+            // Num division is always a float division
+            const char *is_float = new_label();
+            emit("TYPE %s %s", R_TA, R_X);
+            emit("JUMPIFEQ %s %s string@float", is_float, R_TA);
+            emit("INT2FLOAT %s %s", R_X, R_X);
+            emit("INT2FLOAT %s %s", R_Y, R_Y);
+            emit("LABEL %s", is_float);
+            emit("DIV %s %s %s", dst, R_X, R_Y);
+            break;
+        }
+        default:
+            error_exit(99, "Internal: bad arithmetic operator\n");
+    }
+
+    if (end)
+        emit("LABEL %s", end);
+}
+
+static void emit_relational(IROp op, const char *dst, Val a, Val b)
+{
+    const char *x = R_X, *y = R_Y;
+
+    if (static_num_pair(&a, &b, false)) {
+        x = a.s;
+        y = b.s;
+    } else {
+        emit_types(a.s, b.s);
+        emit_num_pair(a.s, b.s);
+    }
+
+    switch (op) {
+        case IR_LT: emit("LT %s %s %s", dst, x, y); break;
+        case IR_GT: emit("GT %s %s %s", dst, x, y); break;
+        case IR_LE: emit("GT %s %s %s", dst, x, y); emit("NOT %s %s", dst, dst); break;
+        case IR_GE: emit("LT %s %s %s", dst, x, y); emit("NOT %s %s", dst, dst); break;
+        default:
+            error_exit(99, "Internal: bad relational operator\n");
+    }
+}
+
+// == / != never fail: values of different types are unequal,
+// except int and float which compare numerically
+static void emit_equality(IROp op, const char *dst, Val a, Val b)
+{
+    bool a_num = a.mask & TYPEMASK_NUM, b_num = b.mask & TYPEMASK_NUM;
+
+    if (!(a.mask & b.mask) && !(a_num && b_num)) {
+        // no common type, the answer is known
+        emit("MOVE %s bool@%s", dst, op == IR_NE ? "true" : "false");
+        return;
+    }
+
+    // EQ handles operands of one type, and nil against anything
+    if ((a.mask == b.mask && (a.mask & (a.mask - 1)) == 0) ||
+        a.mask == TYPEMASK_NULL || b.mask == TYPEMASK_NULL ||
+        static_num_pair(&a, &b, false)) {
+        emit("EQ %s %s %s", dst, a.s, b.s);
+        if (op == IR_NE)
+            emit("NOT %s %s", dst, dst);
+        return;
+    }
+
+    const char *same = new_label();
+    const char *a_int = new_label();
+    const char *end = new_label();
+
+    emit_types(a.s, b.s);
+    emit("JUMPIFEQ %s %s %s", same, R_TA, R_TB);
+    emit("MOVE %s bool@false", dst);
+
+    emit("JUMPIFEQ %s %s string@int", a_int, R_TA);
+    emit("JUMPIFNEQ %s %s string@float", end, R_TA);
+    emit("JUMPIFNEQ %s %s string@int", end, R_TB);
+    emit("INT2FLOAT %s %s", R_Y, b.s);
+    emit("EQ %s %s %s", dst, a.s, R_Y);
+    emit("JUMP %s", end);
+
+    emit("LABEL %s", a_int);
+    emit("JUMPIFNEQ %s %s string@float", end, R_TB);
+    emit("INT2FLOAT %s %s", R_X, a.s);
+    emit("EQ %s %s %s", dst, R_X, b.s);
+    emit("JUMP %s", end);
+
+    emit("LABEL %s", same);
+    emit("EQ %s %s %s", dst, a.s, b.s);
+
+    emit("LABEL %s", end);
+    if (op == IR_NE)
+        emit("NOT %s %s", dst, dst);
+}
+
+static void emit_is(const char *dst, Val v, int type_mask)
+{
+    const char *a = v.s;
+
+    // decided by the analysis: always / never of that type
+    if (!(v.mask & ~type_mask) || !(v.mask & type_mask)) {
+        emit("MOVE %s bool@%s", dst, (v.mask & type_mask) ? "true" : "false");
+        return;
+    }
+
+    emit("TYPE %s %s", R_TA, a);
+
+    switch (type_mask) {
+        case TYPEMASK_NUM: {
+            const char *end = new_label();
+            emit("EQ %s %s string@int", dst, R_TA);
+            emit("JUMPIFEQ %s %s bool@true", end, dst);
+            emit("EQ %s %s string@float", dst, R_TA);
+            emit("LABEL %s", end);
+            break;
+        }
+        case TYPEMASK_STRING:
+            emit("EQ %s %s string@string", dst, R_TA);
+            break;
+        case TYPEMASK_NULL:
+            emit("EQ %s %s string@nil", dst, R_TA);
+            break;
+        default:
+            error_exit(99, "Internal: bad 'is' type\n");
+    }
+}
+
+/* ---------------------------------------------------------
+   Shared dispatch helpers
+   The TYPE dispatch of an operator can also live in one
+   routine per operator ($$rt_add, $$rt_eq, ..). Operands are
+   passed on the data stack and the result comes back there;
+   the helpers need no frame. CodeGenOptions.dispatch decides
+   between the inline sequence and a call.
+   --------------------------------------------------------- */
+
+// operator helpers; LE, GE and NE reuse GT, LT and EQ
+static const char *helper_names[] = {
+    [IR_ADD] = "add", [IR_SUB] = "sub", [IR_MUL] = "mul", [IR_DIV] = "div",
+    [IR_LT] = "lt",   [IR_GT] = "gt",   [IR_EQ] = "eq"
+};
+
+static IROp helper_op(IROp op)
+{
+    switch (op) {
+        case IR_LE: return IR_GT;
+        case IR_GE: return IR_LT;
+        case IR_NE: return IR_EQ;
+        default:    return op;
+    }
+}
+
+// would the operator fall back to the generic TYPE dispatch?
+static bool needs_dispatch(const IRInstr *in)
+{
+    TypeMask a = ir_operand_mask(cg.fn, in->a), b = ir_operand_mask(cg.fn, in->b);
+    bool nums = is_exact_num(a) && is_exact_num(b);
+
+    switch (in->op) {
+        case IR_ADD:
+            return !nums && !(a == TYPEMASK_STRING && b == TYPEMASK_STRING);
+        case IR_SUB: case IR_MUL: case IR_DIV:
+        case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            return !nums;
+        case IR_EQ: case IR_NE: {
+            bool a_num = a & TYPEMASK_NUM, b_num = b & TYPEMASK_NUM;
+            if (nums || (!(a & b) && !(a_num && b_num)))
+                return false;
+            return !((a == b && (a & (a - 1)) == 0) ||
+                     a == TYPEMASK_NULL || b == TYPEMASK_NULL);
+        }
+        default:
+            return false;
+    }
+}
+
+// a helper (its generic body included) pays off from the third site on
+#define HELPER_MIN_SITES 3
+
+static bool use_helper(const IRInstr *in, int block)
+{
+    switch (cg.opts.dispatch) {
+        case CG_DISPATCH_INLINE: return false;
+        case CG_DISPATCH_SHARED: return needs_dispatch(in);
+        default:
+            return needs_dispatch(in) && !cg.in_loop[block] &&
+                   cg.helper_sites[helper_op(in->op)] >= HELPER_MIN_SITES;
+    }
+}
+
+static void emit_helper_call(const IRInstr *in)
+{
+    IROp op = helper_op(in->op);
+    const char *dst = operand(in->dst);
+
+    cg.helpers_used |= 1u << op;
+    emit("PUSHS %s", operand(in->a));
+    emit("PUSHS %s", operand(in->b));
+    emit("CALL $$rt_%s", helper_names[op]);
+    emit("POPS %s", dst);
+    if (op != in->op)
+        emit("NOT %s %s", dst, dst);
+}
+
+// the inline sequences above, between POPS and PUSHS
+static void gen_helper(IROp op)
+{
+    Val a = { R_X, TYPEMASK_ALL }, b = { R_Y, TYPEMASK_ALL };
+
+    emit("");
+    emit("LABEL $$rt_%s", helper_names[op]);
+    emit("POPS %s", R_Y);
+    emit("POPS %s", R_X);
+    switch (op) {
+        case IR_EQ: emit_equality(op, R_R, a, b); break;
+        case IR_LT:
+        case IR_GT: emit_relational(op, R_R, a, b); break;
+        default:    emit_arith(op, R_R, a, b); break;
+    }
+    emit("PUSHS %s", R_R);
+    emit("RETURN");
+}
+
+// blocks between a backward jump and its target form a loop
+static void find_loops(const IRFunc *fn)
+{
+    cg.in_loop = calloc((size_t)fn->block_count + 1, sizeof(bool));
+    if (!cg.in_loop)
+        error_exit(99, "Out of memory (loops)\n");
+
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        if (!bb->count)
+            continue;
+        const IRInstr *in = &bb->code[bb->count - 1];
+        int n = in->op == IR_JUMP ? 1 : in->op == IR_BRANCH ? 2 : 0;
+        for (int t = 0; t < n; t++)
+            for (int h = in->target[t]; h <= b; h++)
+                cg.in_loop[h] = true;
+    }
+}
+
+// CG_DISPATCH_AUTO: how many sites outside loops each helper would serve
+static void count_helper_sites(const IRProgram *prog)
+{
+    for (int f = 0; f < prog->func_count; f++) {
+        cg.fn = prog->funcs[f];
+        find_loops(cg.fn);
+        for (int b = 0; b < cg.fn->block_count; b++) {
+            const IRBlock *bb = cg.fn->blocks[b];
+            for (int i = 0; i < bb->count; i++)
+                if (!cg.in_loop[b] && needs_dispatch(&bb->code[i]))
+                    cg.helper_sites[helper_op(bb->code[i].op)]++;
+        }
+        free(cg.in_loop);
+        cg.in_loop = NULL;
+    }
+    cg.fn = NULL;
+}
+
+/* ---------------------------------------------------------
+   Calls
+   --------------------------------------------------------- */
+
+// user function, getter or setter: arguments go to TF@%1.., result in TF@%retval
+static void emit_call(const char *label, const IROperand *args, int argc)
+{
+    emit("CREATEFRAME");
+    for (int i = 0; i < argc; i++) {
+        emit("DEFVAR TF@%%%d", i + 1);
+        emit("MOVE TF@%%%d %s", i + 1, operand(args[i]));
+    }
+    emit("CALL $%s", label);
+}
+
+static const char *builtin_routines[] = {
+    [BI_FLOOR] = "floor", [BI_STR] = "str", [BI_LENGTH] = "length",
+    [BI_SUBSTRING] = "substring", [BI_STRCMP] = "strcmp",
+    [BI_ORD] = "ord", [BI_CHR] = "chr"
+};
+
+static void emit_builtin(const IRInstr *in)
+{
+    const char *dst = in->dst.kind != IR_OPD_NONE ? operand(in->dst) : NULL;
+
+    switch ((BuiltinId)in->aux) {
+        case BI_WRITE: {
+            if (!(ir_operand_mask(cg.fn, in->args[0]) & TYPEMASK_FLOAT)) {
+                emit("WRITE %s", operand(in->args[0]));
+                if (dst)
+                    emit("MOVE %s nil@nil", dst);
+                return;
+            }
+
+            // integral floats print like ints
+            const char *end = new_label();
+            emit("MOVE %s %s", R_X, operand(in->args[0]));
+            if (ir_operand_mask(cg.fn, in->args[0]) != TYPEMASK_FLOAT) {
+                emit("TYPE %s %s", R_TA, R_X);
+                emit("JUMPIFNEQ %s %s string@float", end, R_TA);
+            }
+            emit("ISINT %s %s", R_TA, R_X);
+            emit("JUMPIFEQ %s %s bool@false", end, R_TA);
+            emit("FLOAT2INT %s %s", R_X, R_X);
+            emit("LABEL %s", end);
+            emit("WRITE %s", R_X);
+            if (dst)
+                emit("MOVE %s nil@nil", dst);
+            return;
+        }
+
+        case BI_READ_STR:
+            emit("READ %s string", dst ? dst : R_X);
+            return;
+
+        case BI_READ_NUM: {
+            // integral input stays an int, like a literal would
+            const char *r = dst ? dst : R_X;
+            const char *end = new_label();
+            emit("READ %s float", r);
+            emit("TYPE %s %s", R_TA, r);
+            emit("JUMPIFEQ %s %s string@nil", end, R_TA);
+            emit("ISINT %s %s", R_TA, r);
+            emit("JUMPIFEQ %s %s bool@false", end, R_TA);
+            emit("FLOAT2INT %s %s", r, r);
+            emit("LABEL %s", end);
+            return;
+        }
+
+        default:
+            // the rest are shared routines emitted once at the end
+            cg.builtins_used |= 1u << in->aux;
+            emit_call(op_fmt("$ifj_%s", builtin_routines[in->aux]), in->args, in->argc);
+            if (dst)
+                emit("MOVE %s TF@%%retval", dst);
+            return;
+    }
+}
+
+/* ---------------------------------------------------------
+   Expression stack (CodeGenOptions.stack_exprs)
+   A temporary that is produced by a statically typed operator
+   and read exactly once, later in the same block, is never
+   stored: its value stays on the data stack until the user
+   pops it. Operands that are plain variables or constants are
+   pushed right before the operator, so a chain of such
+   operators becomes postfix code (PUSHS/ADDS/LTS/..).
+   --------------------------------------------------------- */
+
+// operator with a PUSHS/..S form: Num operands of proven
+// representation, or an equality EQ can decide on its own
+static bool stack_op(const IRInstr *in)
+{
+    TypeMask a = ir_operand_mask(cg.fn, in->a), b = ir_operand_mask(cg.fn, in->b);
+
+    switch (in->op) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+        case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            return is_exact_num(a) && is_exact_num(b);
+        case IR_EQ: case IR_NE:
+            if (is_exact_num(a) && is_exact_num(b))
+                return true;
+            return (a & b) && ((a == b && (a & (a - 1)) == 0) ||
+                               a == TYPEMASK_NULL || b == TYPEMASK_NULL);
+        default:
+            return false;
+    }
+}
+
+// a op b == b op' a
+static bool stack_swappable(IROp op)
+{
+    return op != IR_SUB && op != IR_DIV;
+}
+
+static IROp stack_swapped(IROp op)
+{
+    switch (op) {
+        case IR_LT: return IR_GT;
+        case IR_GT: return IR_LT;
+        case IR_LE: return IR_GE;
+        case IR_GE: return IR_LE;
+        default:    return op;
+    }
+}
+
+// int operand `o` of `in` that has to become a float first
+static bool stack_needs_float(const IRInstr *in, IROperand o)
+{
+    TypeMask a = ir_operand_mask(cg.fn, in->a), b = ir_operand_mask(cg.fn, in->b);
+
+    if (ir_operand_mask(cg.fn, o) != TYPEMASK_INT || !is_exact_num(a) || !is_exact_num(b))
+        return false;
+    return in->op == IR_DIV || a == TYPEMASK_FLOAT || b == TYPEMASK_FLOAT;
+}
+
+static bool stack_resident(IROperand o)
+{
+    return cg.on_stack && o.kind == IR_OPD_VAR && cg.on_stack[o.u.var];
+}
+
+// can `in` take the value of its operand `o` from the top of the stack?
+static bool stack_consumer(const IRInstr *in, const IROperand *o)
+{
+    switch (in->op) {
+        case IR_MOVE:
+        case IR_RETURN:
+            return o == &in->a;
+        case IR_BRANCH:
+            return o == &in->a && ir_operand_mask(cg.fn, in->a) == TYPEMASK_BOOL;
+        default:
+            return (o == &in->a || o == &in->b) && stack_op(in);
+    }
+}
+
+static void stack_count_use(int *uses, IROperand o)
+{
+    if (o.kind == IR_OPD_VAR)
+        uses[o.u.var]++;
+}
+
+// the instruction after `def` in `bb` that reads var `v`, if it may pop it
+static bool stack_single_user(const IRBlock *bb, int def, int v)
+{
+    for (int i = def + 1; i < bb->count; i++) {
+        const IRInstr *in = &bb->code[i];
+        if (in->a.kind == IR_OPD_VAR && in->a.u.var == v)
+            return stack_consumer(in, &in->a);
+        if (in->b.kind == IR_OPD_VAR && in->b.u.var == v)
+            return stack_consumer(in, &in->b);
+        for (int j = 0; j < in->argc; j++)
+            if (in->args[j].kind == IR_OPD_VAR && in->args[j].u.var == v)
+                return false;
+    }
+    return false;
+}
+
+// operands of `in` in push order; `*swap` when b has to go first
+static void stack_order(const IRInstr *in, IROperand *first, IROperand *second, bool *swap)
+{
+    *swap = stack_op(in) && !stack_resident(in->a) && stack_resident(in->b);
+    *first = *swap ? in->b : in->a;
+    *second = *swap ? in->a : in->b;
+}
+
+// replays the block's pushes and pops; drops a temp from the stack
+// when its value would not be on top at its use, false if it did
+static bool stack_check_block(const IRBlock *bb, int *stack)
+{
+    int depth = 0;
+
+    for (int i = 0; i < bb->count; i++) {
+        const IRInstr *in = &bb->code[i];
+        IROperand pops[2];
+        int n = 0;
+
+        if (stack_op(in)) {
+            IROperand first, second;
+            bool swap;
+            stack_order(in, &first, &second, &swap);
+
+            if (swap && !stack_swappable(in->op)) {
+                cg.on_stack[in->b.u.var] = false;
+                return false;
+            }
+            if (stack_resident(first) && stack_resident(second) &&
+                stack_needs_float(in, first)) {
+                // the conversion would have to reach below the top
+                cg.on_stack[second.u.var] = false;
+                return false;
+            }
+            if (stack_resident(first))
+                pops[n++] = first;
+            if (stack_resident(second))
+                pops[n++] = second;
+        } else if (stack_resident(in->a)) {
+            pops[n++] = in->a;
+        }
+
+        for (int k = 0; k < n; k++) {
+            if (depth - n + k < 0 || stack[depth - n + k] != pops[k].u.var) {
+                for (int m = 0; m < n; m++)
+                    cg.on_stack[pops[m].u.var] = false;
+                return false;
+            }
+        }
+        depth -= n;
+
+        if (in->dst.kind == IR_OPD_VAR && cg.on_stack[in->dst.u.var])
+            stack[depth++] = in->dst.u.var;
+    }
+
+    for (int k = 0; k < depth; k++)
+        cg.on_stack[stack[k]] = false;
+    return depth == 0;
+}
+
+static void stack_plan(const IRFunc *fn)
+{
+    int *uses = calloc((size_t)fn->var_count + 1, sizeof(int));
+    cg.on_stack = calloc((size_t)fn->var_count + 1, sizeof(bool));
+    if (!uses || !cg.on_stack)
+        error_exit(99, "Out of memory (expression stack)\n");
+
+    int longest = 1;
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        if (bb->count > longest)
+            longest = bb->count;
+        for (int i = 0; i < bb->count; i++) {
+            stack_count_use(uses, bb->code[i].a);
+            stack_count_use(uses, bb->code[i].b);
+            for (int j = 0; j < bb->code[i].argc; j++)
+                stack_count_use(uses, bb->code[i].args[j]);
+        }
+    }
+
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        for (int i = 0; i < bb->count; i++) {
+            const IRInstr *in = &bb->code[i];
+            if (!stack_op(in) || in->dst.kind != IR_OPD_VAR)
+                continue;
+            int v = in->dst.u.var;
+            cg.on_stack[v] = fn->vars[v].kind == IR_VAR_TEMP && uses[v] == 1 &&
+                             stack_single_user(bb, i, v);
+        }
+    }
+
+    // each failed check drops one or more temps, so this terminates
+    int *stack = malloc((size_t)longest * sizeof(int));
+    if (!stack)
+        error_exit(99, "Out of memory (expression stack)\n");
+    for (int b = 0; b < fn->block_count; b++)
+        while (!stack_check_block(fn->blocks[b], stack))
+            ;
+
+    free(stack);
+    free(uses);
+}
+
+static void stack_push(const IRInstr *in, IROperand o)
+{
+    bool to_float = stack_needs_float(in, o);
+
+    if (!stack_resident(o)) {
+        const char *s = operand(o);
+        if (to_float && o.kind == IR_OPD_INT) {
+            emit("PUSHS %s", op_fmt("float@%a", (double)o.u.i));
+            return;
+        }
+        emit("PUSHS %s", s);
+    }
+    if (to_float)
+        emit("INT2FLOATS");
+}
+
+static void emit_stack_op(const IRInstr *in)
+{
+    IROperand first, second;
+    bool swap;
+    stack_order(in, &first, &second, &swap);
+
+    stack_push(in, first);
+    stack_push(in, second);
+
+    switch (swap ? stack_swapped(in->op) : in->op) {
+        case IR_ADD: emit("ADDS"); break;
+        case IR_SUB: emit("SUBS"); break;
+        case IR_MUL: emit("MULS"); break;
+        case IR_DIV: emit("DIVS"); break;
+        case IR_LT:  emit("LTS"); break;
+        case IR_GT:  emit("GTS"); break;
+        case IR_LE:  emit("GTS"); emit("NOTS"); break;
+        case IR_GE:  emit("LTS"); emit("NOTS"); break;
+        case IR_EQ:  emit("EQS"); break;
+        case IR_NE:  emit("EQS"); emit("NOTS"); break;
+        default:
+            error_exit(99, "Internal: bad stack operator\n");
+    }
+
+    if (!stack_resident(in->dst))
+        emit("POPS %s", operand(in->dst));
+}
+
+/* ---------------------------------------------------------
+   Instructions
+   --------------------------------------------------------- */
+
+// jumps to block `target` unless it is laid out right after `from`
+static void emit_jump(int from, int target)
+{
+    if (target != from + 1)
+        emit("JUMP %s", block_label(target));
+}
+
+// relational results are bools already, anything else is truthy
+// unless it is null or false
+static void emit_branch(const IRInstr *in, int from)
+{
+    const char *v = operand(in->a);
+    const char *if_false = block_label(in->target[1]);
+    TypeMask mask = ir_operand_mask(cg.fn, in->a);
+
+    if (mask == TYPEMASK_NULL) {
+        emit_jump(from, in->target[1]);
+        return;
+    }
+    if (!(mask & (TYPEMASK_NULL | TYPEMASK_BOOL))) {
+        // never null or a bool, always truthy
+        emit_jump(from, in->target[0]);
+        return;
+    }
+
+    if (mask == TYPEMASK_BOOL && stack_resident(in->a)) {
+        emit("PUSHS bool@false");
+        emit("JUMPIFEQS %s", if_false);
+    } else if (mask == TYPEMASK_BOOL) {
+        emit("JUMPIFEQ %s %s bool@false", if_false, v);
+    } else {
+        const char *truthy = new_label();
+        emit("TYPE %s %s", R_TA, v);
+        emit("JUMPIFEQ %s %s string@nil", if_false, R_TA);
+        emit("JUMPIFNEQ %s %s string@bool", truthy, R_TA);
+        emit("JUMPIFEQ %s %s bool@false", if_false, v);
+        emit("LABEL %s", truthy);
+    }
+    emit_jump(from, in->target[0]);
+}
+
+static void emit_instr(const IRInstr *in, int block)
+{
+    if (cg.on_stack && stack_op(in) &&
+        (stack_resident(in->dst) || stack_resident(in->a) || stack_resident(in->b))) {
+        emit_stack_op(in);
+        return;
+    }
+
+    if (use_helper(in, block)) {
+        emit_helper_call(in);
+        return;
+    }
+
+    switch (in->op) {
+        case IR_MOVE:
+            if (stack_resident(in->a))
+                emit("POPS %s", operand(in->dst));
+            else
+                emit("MOVE %s %s", operand(in->dst), operand(in->a));
+            break;
+
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+            emit_arith(in->op, operand(in->dst), value(in->a), value(in->b));
+            break;
+
+        case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            emit_relational(in->op, operand(in->dst), value(in->a), value(in->b));
+            break;
+
+        case IR_EQ: case IR_NE:
+            emit_equality(in->op, operand(in->dst), value(in->a), value(in->b));
+            break;
+
+        case IR_IS:
+            emit_is(operand(in->dst), value(in->a), in->aux);
+            break;
+
+        case IR_CALL:
+            emit_call(in->func, in->args, in->argc);
+            if (in->dst.kind != IR_OPD_NONE)
+                emit("MOVE %s TF@%%retval", operand(in->dst));
+            break;
+
+        case IR_BUILTIN:
+            emit_builtin(in);
+            break;
+
+        case IR_JUMP:
+            emit_jump(block, in->target[0]);
+            break;
+
+        case IR_BRANCH:
+            emit_branch(in, block);
+            break;
+
+        case IR_RETURN:
+            if (stack_resident(in->a))
+                emit("POPS LF@%%retval");
+            else
+                emit("MOVE LF@%%retval %s", operand(in->a));
+            emit("POPFRAME");
+            emit("RETURN");
+            break;
+    }
+}
+
+/* ---------------------------------------------------------
+   Functions
+   --------------------------------------------------------- */
+
+static void gen_function(const IRFunc *fn)
+{
+    cg.fn = fn;
+    cg.block_label = cg.label_count;
+    cg.label_count += fn->block_count;
+
+    emit("");
+    emit("LABEL $%s", fn->name);
+    emit("PUSHFRAME");
+    emit("DEFVAR LF@%%retval");
+
+    if (cg.opts.stack_exprs)
+        stack_plan(fn);
+    find_loops(fn);
+    cg.slot = ir_assign_slots(fn, cg.on_stack);
+
+    // one per slot, loop bodies then only MOVE into them
+    for (int i = 0; i < fn->var_count; i++)
+        if (fn->vars[i].kind != IR_VAR_PARAM && cg.slot[i] == i &&
+            !(cg.on_stack && cg.on_stack[i]))
+            emit("DEFVAR %s", operand(ir_var(i)));
+
+    // block 0 only needs a label when a (tail call) jump goes back to it
+    bool entry_target = false;
+    for (int b = 0; b < fn->block_count && !entry_target; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        const IRInstr *t = bb->count ? &bb->code[bb->count - 1] : NULL;
+        entry_target = t && ((t->op == IR_JUMP && t->target[0] == 0) ||
+                             (t->op == IR_BRANCH && (t->target[0] == 0 || t->target[1] == 0)));
+    }
+
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        if (b > 0 || entry_target)
+            emit("LABEL %s", block_label(b));
+        for (int i = 0; i < bb->count; i++)
+            emit_instr(&bb->code[i], b);
+    }
+
+    free(cg.on_stack);
+    cg.on_stack = NULL;
+    free(cg.slot);
+    cg.slot = NULL;
+    free(cg.in_loop);
+    cg.in_loop = NULL;
+    op_reset();
+}
+
+/* ---------------------------------------------------------
+   Runtime
+   --------------------------------------------------------- */
+
+// converts LF@%<arg> to an int in place: int stays, integral float
+// is converted, other floats exit 26 and non-numbers exit 25
+static void emit_rt_to_int(const char *fn, int arg)
+{
+    emit("TYPE LF@%%t LF@%%%d", arg);
+    emit("JUMPIFEQ $$ifj_%s$int%d LF@%%t string@int", fn, arg);
+    emit("JUMPIFNEQ %s LF@%%t string@float", ERR_PARAM_LABEL);
+    emit("ISINT LF@%%t LF@%%%d", arg);
+    emit("JUMPIFNEQ %s LF@%%t bool@true", ERR_TYPE_LABEL);
+    emit("FLOAT2INT LF@%%%d LF@%%%d", arg, arg);
+    emit("LABEL $$ifj_%s$int%d", fn, arg);
+}
+
+static void emit_rt_expect_string(int arg)
+{
+    emit("TYPE LF@%%t LF@%%%d", arg);
+    emit("JUMPIFNEQ %s LF@%%t string@string", ERR_PARAM_LABEL);
+}
+
+static void emit_rt_begin(const char *fn)
+{
+    emit("");
+    emit("LABEL $$ifj_%s", fn);
+    emit("PUSHFRAME");
+    emit("DEFVAR LF@%%retval");
+    emit("DEFVAR LF@%%t");
+}
+
+static void emit_rt_return(void)
+{
+    emit("POPFRAME");
+    emit("RETURN");
+}
+
+static void gen_runtime_builtin(BuiltinId id)
+{
+    switch (id) {
+        case BI_FLOOR:
+            emit_rt_begin("floor");
+            emit("TYPE LF@%%t LF@%%1");
+            emit("MOVE LF@%%retval LF@%%1");
+            emit("JUMPIFEQ $$ifj_floor$done LF@%%t string@int");
+            emit("JUMPIFNEQ %s LF@%%t string@float", ERR_PARAM_LABEL);
+            emit("FLOAT2INT LF@%%retval LF@%%1");
+            emit("INT2FLOAT LF@%%t LF@%%retval");
+            emit("GT LF@%%t LF@%%t LF@%%1");
+            emit("JUMPIFEQ $$ifj_floor$done LF@%%t bool@false");
+            emit("SUB LF@%%retval LF@%%retval int@1");
+            emit("LABEL $$ifj_floor$done");
+            emit_rt_return();
+            break;
+
+        case BI_STR:
+            emit_rt_begin("str");
+            emit("TYPE LF@%%t LF@%%1");
+            emit("MOVE LF@%%retval LF@%%1");
+            emit("JUMPIFEQ $$ifj_str$done LF@%%t string@string");
+            emit("MOVE LF@%%retval string@null");
+            emit("JUMPIFEQ $$ifj_str$done LF@%%t string@nil");
+            emit("JUMPIFEQ $$ifj_str$int LF@%%t string@int");
+            emit("JUMPIFEQ $$ifj_str$float LF@%%t string@float");
+            emit("MOVE LF@%%retval string@true");
+            emit("JUMPIFEQ $$ifj_str$done LF@%%1 bool@true");
+            emit("MOVE LF@%%retval string@false");
+            emit("JUMP $$ifj_str$done");
+            emit("LABEL $$ifj_str$int");
+            emit("INT2STR LF@%%retval LF@%%1");
+            emit("JUMP $$ifj_str$done");
+            emit("LABEL $$ifj_str$float");
+            emit("ISINT LF@%%t LF@%%1");
+            emit("JUMPIFEQ $$ifj_str$frac LF@%%t bool@false");
+            emit("FLOAT2INT LF@%%retval LF@%%1");
+            emit("INT2STR LF@%%retval LF@%%retval");
+            emit("JUMP $$ifj_str$done");
+            emit("LABEL $$ifj_str$frac");
+            emit("FLOAT2STR LF@%%retval LF@%%1");
+            emit("LABEL $$ifj_str$done");
+            emit_rt_return();
+            break;
+
+        case BI_LENGTH:
+            emit_rt_begin("length");
+            emit_rt_expect_string(1);
+            emit("STRLEN LF@%%retval LF@%%1");
+            emit_rt_return();
+            break;
+
+        case BI_SUBSTRING:
+            // null unless 0 <= i <= j, i < length(s), j <= length(s)
+            emit_rt_begin("substring");
+            emit_rt_expect_string(1);
+            emit_rt_to_int("substring", 2);
+            emit_rt_to_int("substring", 3);
+            emit("DEFVAR LF@%%len");
+            emit("STRLEN LF@%%len LF@%%1");
+            emit("MOVE LF@%%retval nil@nil");
+            emit("LT LF@%%t LF@%%2 int@0");
+            emit("JUMPIFEQ $$ifj_substring$done LF@%%t bool@true");
+            emit("GT LF@%%t LF@%%2 LF@%%3");
+            emit("JUMPIFEQ $$ifj_substring$done LF@%%t bool@true");
+            emit("LT LF@%%t LF@%%2 LF@%%len");
+            emit("JUMPIFEQ $$ifj_substring$done LF@%%t bool@false");
+            emit("GT LF@%%t LF@%%3 LF@%%len");
+            emit("JUMPIFEQ $$ifj_substring$done LF@%%t bool@true");
+            emit("MOVE LF@%%retval string@");
+            emit("LABEL $$ifj_substring$loop");
+            emit("JUMPIFEQ $$ifj_substring$done LF@%%2 LF@%%3");
+            emit("GETCHAR LF@%%t LF@%%1 LF@%%2");
+            emit("CONCAT LF@%%retval LF@%%retval LF@%%t");
+            emit("ADD LF@%%2 LF@%%2 int@1");
+            emit("JUMP $$ifj_substring$loop");
+            emit("LABEL $$ifj_substring$done");
+            emit_rt_return();
+            break;
+
+        case BI_STRCMP:
+            emit_rt_begin("strcmp");
+            emit_rt_expect_string(1);
+            emit_rt_expect_string(2);
+            emit("MOVE LF@%%retval int@-1");
+            emit("LT LF@%%t LF@%%1 LF@%%2");
+            emit("JUMPIFEQ $$ifj_strcmp$done LF@%%t bool@true");
+            emit("MOVE LF@%%retval int@0");
+            emit("JUMPIFEQ $$ifj_strcmp$done LF@%%1 LF@%%2");
+            emit("MOVE LF@%%retval int@1");
+            emit("LABEL $$ifj_strcmp$done");
+            emit_rt_return();
+            break;
+
+        case BI_ORD:
+            // 0 for an empty string or an index out of range
+            emit_rt_begin("ord");
+            emit_rt_expect_string(1);
+            emit_rt_to_int("ord", 2);
+            emit("MOVE LF@%%retval int@0");
+            emit("LT LF@%%t LF@%%2 int@0");
+            emit("JUMPIFEQ $$ifj_ord$done LF@%%t bool@true");
+            emit("STRLEN LF@%%t LF@%%1");
+            emit("LT LF@%%t LF@%%2 LF@%%t");
+            emit("JUMPIFEQ $$ifj_ord$done LF@%%t bool@false");
+            emit("STRI2INT LF@%%retval LF@%%1 LF@%%2");
+            emit("LABEL $$ifj_ord$done");
+            emit_rt_return();
+            break;
+
+        case BI_CHR:
+            emit_rt_begin("chr");
+            emit_rt_to_int("chr", 1);
+            emit("INT2CHAR LF@%%retval LF@%%1");
+            emit_rt_return();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void gen_runtime(void)
+{
+    emit("");
+    emit("LABEL %s", ERR_TYPE_LABEL);
+    emit("EXIT int@26");
+    emit("LABEL %s", ERR_PARAM_LABEL);
+    emit("EXIT int@25");
+
+    for (int id = 0; id < 32; id++)
+        if (cg.builtins_used & (1u << id))
+            gen_runtime_builtin((BuiltinId)id);
+
+    for (int op = 0; op < 32; op++)
+        if (cg.helpers_used & (1u << op))
+            gen_helper((IROp)op);
+}
+
+/* ---------------------------------------------------------
+   Program
+   --------------------------------------------------------- */
+
+static void gen_globals(const IRProgram *prog)
+{
+    emit("DEFVAR %s", R_TA);
+    emit("DEFVAR %s", R_TB);
+    emit("DEFVAR %s", R_X);
+    emit("DEFVAR %s", R_Y);
+    emit("DEFVAR %s", R_R);
+
+    for (int i = 0; i < prog->global_count; i++) {
+        emit("DEFVAR GF@%s", prog->globals[i]);
+        emit("MOVE GF@%s nil@nil", prog->globals[i]);
+    }
+}
+
+char *code_gen_ir_text(const IRProgram *prog, const CodeGenOptions *opts, size_t *len)
+{
+    memset(&cg, 0, sizeof(cg));
+    if (opts)
+        cg.opts = *opts;
+
+    if (cg.opts.dispatch == CG_DISPATCH_AUTO)
+        count_helper_sites(prog);
+
+    emit(".IFJcode25");
+    emit("JUMP $$main");
+
+    for (int i = 0; i < prog->func_count; i++)
+        gen_function(prog->funcs[i]);
+
+    gen_runtime();
+
+    emit("");
+    emit("LABEL $$main");
+    gen_globals(prog);
+    emit("CREATEFRAME");
+    emit("CALL $main$0");
+
+    char *code = peephole_optimize(out_buf.data, out_buf.len, len,
+                                   cg.opts.peephole_stats ? stderr : NULL);
+    op_reset();
+    buf_free(&out_buf);
+    return code;
+}
+
+void code_gen_ir(const IRProgram *prog, const CodeGenOptions *opts)
+{
+    size_t len;
+    char *code = code_gen_ir_text(prog, opts, &len);
+    fwrite(code, 1, len, stdout);
+    fflush(stdout);
+    free(code);
+}
+
+char *code_gen_text(ASTNode *root, const CodeGenOptions *opts, size_t *len)
+{
+    IRProgram *prog = ir_lower(root);
+    ir_optimize(prog);
+    char *code = code_gen_ir_text(prog, opts, len);
+    ir_program_free(prog);
+    return code;
+}
+
+void code_gen(ASTNode *root, const CodeGenOptions *opts)
+{
+    IRProgram *prog = ir_lower(root);
+    ir_optimize(prog);
+    code_gen_ir(prog, opts);
+    ir_program_free(prog);
+}
@@ -0,0 +1,36 @@
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+#include "ir.h"
+
+// how operators whose operand types are only known at run time are emitted
+typedef enum {
+    CG_DISPATCH_AUTO,   // inline inside loops, shared helpers elsewhere
+    CG_DISPATCH_INLINE, // TYPE dispatch at every site (speed)
+    CG_DISPATCH_SHARED  // calls to $$rt_* helpers (size)
+} CodeGenDispatch;
+
+typedef struct {
+    CodeGenDispatch dispatch;
+    bool stack_exprs;   // statically typed expressions on the data stack (PUSHS/ADDS/..)
+    bool peephole_stats; // per-rule peephole counts on stderr
+} CodeGenOptions;
+
+/// Emit IFJcode25 for an analysed AST to stdout.
+/// Lowers the tree to IR first, see code_gen_ir.
+void code_gen(ASTNode *root, const CodeGenOptions *opts);
+
+/// Translate IR to IFJcode25 on stdout.
+/// The whole program is built in memory, passed through the peephole
+/// optimizer and written with a single flush.
+void code_gen_ir(const IRProgram *prog, const CodeGenOptions *opts);
+
+/// Same as code_gen / code_gen_ir, but the program is returned
+/// (malloc'd, NUL-terminated, length in *len) instead of printed.
+char *code_gen_text(ASTNode *root, const CodeGenOptions *opts, size_t *len);
+char *code_gen_ir_text(const IRProgram *prog, const CodeGenOptions *opts, size_t *len);
+
+#endif
@@ -0,0 +1,155 @@
+#include "intern.h"
+#include "err.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_CHUNK_SIZE   16384
+#define INTERN_INITIAL_CAP  256     // power of two
+
+typedef struct InternStr {
+    uint32_t hash;
+    uint32_t id;
+    uint32_t len;
+    char text[];
+} InternStr;
+
+typedef struct InternChunk {
+    struct InternChunk *next;
+    size_t used;
+    size_t cap;
+    char data[];
+} InternChunk;
+
+static InternStr  **slots = NULL;   // open addressing, linear probing
+static uint32_t     slot_cap = 0;
+static uint32_t     count = 0;
+static InternChunk *chunks = NULL;
+static uint32_t     generation = 0;
+
+/* ---------------------------------------------------------
+   Internal Helpers
+   --------------------------------------------------------- */
+
+// FNV-1a
+static uint32_t hash_bytes(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static InternStr *entry_of(const char *s)
+{
+    return (InternStr *)(s - offsetof(InternStr, text));
+}
+
+static void *chunk_alloc(size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+
+    if (!chunks || chunks->used + size > chunks->cap) {
+        size_t cap = size > INTERN_CHUNK_SIZE ? size : INTERN_CHUNK_SIZE;
+        InternChunk *c = malloc(sizeof(InternChunk) + cap);
+        if (!c)
+            error_exit(99, "Out of memory (intern)\n");
+        c->next = chunks;
+        c->used = 0;
+        c->cap = cap;
+        chunks = c;
+    }
+
+    void *p = chunks->data + chunks->used;
+    chunks->used += size;
+    return p;
+}
+
+static void table_grow(void)
+{
+    uint32_t new_cap = slot_cap ? slot_cap * 2 : INTERN_INITIAL_CAP;
+    InternStr **new_slots = calloc(new_cap, sizeof(InternStr *));
+    if (!new_slots)
+        error_exit(99, "Out of memory (intern table)\n");
+
+    for (uint32_t i = 0; i < slot_cap; i++) {
+        InternStr *e = slots[i];
+        if (!e) continue;
+        uint32_t j = e->hash & (new_cap - 1);
+        while (new_slots[j])
+            j = (j + 1) & (new_cap - 1);
+        new_slots[j] = e;
+    }
+
+    free(slots);
+    slots = new_slots;
+    slot_cap = new_cap;
+}
+
+/* ---------------------------------------------------------
+   API
+   --------------------------------------------------------- */
+
+const char *intern(const char *s, size_t len)
+{
+    if ((count + 1) * 2 > slot_cap)
+        table_grow();
+
+    uint32_t h = hash_bytes(s, len);
+    uint32_t i = h & (slot_cap - 1);
+
+    for (InternStr *e; (e = slots[i]) != NULL; i = (i + 1) & (slot_cap - 1)) {
+        if (e->hash == h && e->len == len && memcmp(e->text, s, len) == 0)
+            return e->text;
+    }
+
+    InternStr *e = chunk_alloc(sizeof(InternStr) + len + 1);
+    e->hash = h;
+    e->id   = count++;
+    e->len  = (uint32_t)len;
+    memcpy(e->text, s, len);
+    e->text[len] = '\0';
+
+    slots[i] = e;
+    return e->text;
+}
+
+const char *intern_cstr(const char *s)
+{
+    return intern(s, strlen(s));
+}
+
+uint32_t intern_hash(const char *s)
+{
+    return entry_of(s)->hash;
+}
+
+uint32_t intern_id(const char *s)
+{
+    return entry_of(s)->id;
+}
+
+size_t intern_len(const char *s)
+{
+    return entry_of(s)->len;
+}
+
+void intern_free(void)
+{
+    while (chunks) {
+        InternChunk *next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+    free(slots);
+    slots = NULL;
+    slot_cap = 0;
+    count = 0;
+    generation++;
+}
+
+uint32_t intern_generation(void)
+{
+    return generation;
+}
@@ -0,0 +1,29 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ---------------------------------------------------------
+   String interning
+   Every distinct string is stored exactly once, so two
+   interned strings are equal iff their pointers are equal.
+   Interned strings stay valid until intern_free().
+   --------------------------------------------------------- */
+
+// intern `len` bytes starting at `s` (need not be NUL-terminated)
+const char *intern(const char *s, size_t len);
+const char *intern_cstr(const char *s);
+
+// O(1) accessors, `s` must come from intern()/intern_cstr()
+uint32_t intern_hash(const char *s);
+uint32_t intern_id(const char *s);      // dense, assigned in interning order
+size_t   intern_len(const char *s);
+
+void intern_free(void);
+
+// bumped by every intern_free(); callers caching interned pointers
+// compare it to tell whether their cache is still valid
+uint32_t intern_generation(void);
+
+#endif
@@ -0,0 +1,290 @@
+// ir.c
+
+#include "ir.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Growable arrays
+   --------------------------------------------------------- */
+
+static void *ir_grow(void *data, int *cap, int need, size_t elem)
+{
+    if (need <= *cap)
+        return data;
+
+    int ncap = *cap ? *cap : 8;
+    while (ncap < need)
+        ncap *= 2;
+
+    void *p = realloc(data, (size_t)ncap * elem);
+    if (!p)
+        error_exit(99, "Out of memory (IR)\n");
+    *cap = ncap;
+    return p;
+}
+
+/* ---------------------------------------------------------
+   Construction
+   --------------------------------------------------------- */
+
+IRProgram *ir_program_new(void)
+{
+    IRProgram *prog = calloc(1, sizeof(IRProgram));
+    if (!prog)
+        error_exit(99, "Out of memory (IR program)\n");
+    return prog;
+}
+
+void ir_func_free(IRFunc *fn)
+{
+    for (int i = 0; i < fn->block_count; i++) {
+        IRBlock *bb = fn->blocks[i];
+        for (int j = 0; j < bb->count; j++)
+            free(bb->code[j].args);
+        free(bb->code);
+        free(bb);
+    }
+    free(fn->blocks);
+    free(fn->vars);
+    free(fn);
+}
+
+void ir_program_free(IRProgram *prog)
+{
+    if (!prog)
+        return;
+    for (int i = 0; i < prog->func_count; i++)
+        ir_func_free(prog->funcs[i]);
+    free(prog->funcs);
+    free(prog->globals);
+    free(prog);
+}
+
+IRFunc *ir_func_new(IRProgram *prog, const char *name, int param_count)
+{
+    IRFunc *fn = calloc(1, sizeof(IRFunc));
+    if (!fn)
+        error_exit(99, "Out of memory (IR function)\n");
+    fn->name = name;
+    fn->param_count = param_count;
+
+    // parameters are vars 0 .. param_count-1
+    for (int i = 0; i < param_count; i++)
+        ir_new_var(fn, IR_VAR_PARAM, NULL, TYPEMASK_ALL);
+
+    prog->funcs = ir_grow(prog->funcs, &prog->func_cap,
+                          prog->func_count + 1, sizeof(IRFunc *));
+    prog->funcs[prog->func_count++] = fn;
+    return fn;
+}
+
+void ir_add_global(IRProgram *prog, const char *name)
+{
+    prog->globals = ir_grow((void *)prog->globals, &prog->global_cap,
+                            prog->global_count + 1, sizeof(const char *));
+    prog->globals[prog->global_count++] = name;
+}
+
+int ir_new_var(IRFunc *fn, IRVarKind kind, const char *name, TypeMask mask)
+{
+    int index = fn->kind_count[kind]++;
+
+    fn->vars = ir_grow(fn->vars, &fn->var_cap, fn->var_count + 1, sizeof(IRVar));
+    fn->vars[fn->var_count] = (IRVar){
+        .kind = kind,
+        .name = name,
+        .index = index,
+        .type_mask = mask
+    };
+    return fn->var_count++;
+}
+
+IRBlock *ir_new_block(IRFunc *fn)
+{
+    IRBlock *bb = calloc(1, sizeof(IRBlock));
+    if (!bb)
+        error_exit(99, "Out of memory (IR block)\n");
+    bb->id = fn->block_count;
+
+    fn->blocks = ir_grow(fn->blocks, &fn->block_cap,
+                         fn->block_count + 1, sizeof(IRBlock *));
+    fn->blocks[fn->block_count++] = bb;
+    return bb;
+}
+
+IRInstr *ir_append(IRBlock *bb, IROp op)
+{
+    bb->code = ir_grow(bb->code, &bb->cap, bb->count + 1, sizeof(IRInstr));
+    IRInstr *in = &bb->code[bb->count++];
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    return in;
+}
+
+/* ---------------------------------------------------------
+   Operands
+   --------------------------------------------------------- */
+
+IROperand ir_none(void)               { return (IROperand){ .kind = IR_OPD_NONE }; }
+IROperand ir_var(int var)             { return (IROperand){ .kind = IR_OPD_VAR, .u.var = var }; }
+IROperand ir_global(const char *name) { return (IROperand){ .kind = IR_OPD_GLOBAL, .u.name = name }; }
+IROperand ir_int(long long v)         { return (IROperand){ .kind = IR_OPD_INT, .u.i = v }; }
+IROperand ir_float(double v)          { return (IROperand){ .kind = IR_OPD_FLOAT, .u.f = v }; }
+IROperand ir_string(const char *s)    { return (IROperand){ .kind = IR_OPD_STRING, .u.name = s }; }
+IROperand ir_bool(bool v)             { return (IROperand){ .kind = IR_OPD_BOOL, .u.b = v }; }
+IROperand ir_nil(void)                { return (IROperand){ .kind = IR_OPD_NIL }; }
+
+TypeMask ir_operand_mask(const IRFunc *fn, IROperand o)
+{
+    switch (o.kind) {
+        case IR_OPD_VAR:
+            if (o.mask)
+                return o.mask;
+            return fn->vars[o.u.var].type_mask ? fn->vars[o.u.var].type_mask : TYPEMASK_ALL;
+        case IR_OPD_GLOBAL: return o.mask ? o.mask : TYPEMASK_ALL;
+        case IR_OPD_INT:    return TYPEMASK_INT;
+        case IR_OPD_FLOAT:  return TYPEMASK_FLOAT;
+        case IR_OPD_STRING: return TYPEMASK_STRING;
+        case IR_OPD_BOOL:   return TYPEMASK_BOOL;
+        case IR_OPD_NIL:    return TYPEMASK_NULL;
+        default:            return TYPEMASK_ALL;
+    }
+}
+
+bool ir_is_terminator(IROp op)
+{
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+bool ir_block_terminated(const IRBlock *bb)
+{
+    return bb->count > 0 && ir_is_terminator(bb->code[bb->count - 1].op);
+}
+
+/* ---------------------------------------------------------
+   Optimization pipeline
+   --------------------------------------------------------- */
+
+void ir_optimize(IRProgram *prog)
+{
+    ir_tail_calls(prog);
+    ir_inline(prog);
+    ir_dead_code(prog);
+    ir_value_numbering(prog);
+    ir_dead_code(prog);         // drops the copies numbering left behind
+    ir_hoist_invariants(prog);
+}
+
+/* ---------------------------------------------------------
+   Debug listing
+   --------------------------------------------------------- */
+
+static const char *op_names[] = {
+    [IR_MOVE] = "move",
+    [IR_ADD] = "add",     [IR_SUB] = "sub",   [IR_MUL] = "mul", [IR_DIV] = "div",
+    [IR_LT] = "lt",       [IR_GT] = "gt",     [IR_LE] = "le",   [IR_GE] = "ge",
+    [IR_EQ] = "eq",       [IR_NE] = "ne",     [IR_IS] = "is",
+    [IR_CALL] = "call",   [IR_BUILTIN] = "builtin",
+    [IR_JUMP] = "jump",   [IR_BRANCH] = "branch", [IR_RETURN] = "return"
+};
+
+static void dump_operand(FILE *out, const IRFunc *fn, IROperand o)
+{
+    switch (o.kind) {
+        case IR_OPD_NONE:   fprintf(out, "_"); break;
+        case IR_OPD_GLOBAL: fprintf(out, "@%s", o.u.name); break;
+        case IR_OPD_INT:    fprintf(out, "%lld", o.u.i); break;
+        case IR_OPD_FLOAT:  fprintf(out, "%a", o.u.f); break;
+        case IR_OPD_STRING: fprintf(out, "\"%s\"", o.u.name); break;
+        case IR_OPD_BOOL:   fprintf(out, "%s", o.u.b ? "true" : "false"); break;
+        case IR_OPD_NIL:    fprintf(out, "null"); break;
+        case IR_OPD_VAR: {
+            const IRVar *v = &fn->vars[o.u.var];
+            if (v->kind == IR_VAR_PARAM)
+                fprintf(out, "%%p%d", v->index);
+            else if (v->kind == IR_VAR_TEMP)
+                fprintf(out, "%%t%d", v->index);
+            else
+                fprintf(out, "%s.%d", v->name, v->index);
+            break;
+        }
+    }
+}
+
+static void dump_instr(FILE *out, const IRFunc *fn, const IRInstr *in)
+{
+    fprintf(out, "    ");
+    if (in->dst.kind != IR_OPD_NONE) {
+        dump_operand(out, fn, in->dst);
+        fprintf(out, " = ");
+    }
+    fprintf(out, "%s", op_names[in->op]);
+
+    switch (in->op) {
+        case IR_JUMP:
+            fprintf(out, " b%d", in->target[0]);
+            break;
+        case IR_BRANCH:
+            fprintf(out, " ");
+            dump_operand(out, fn, in->a);
+            fprintf(out, " b%d b%d", in->target[0], in->target[1]);
+            break;
+        case IR_CALL:
+        case IR_BUILTIN:
+            if (in->op == IR_CALL)
+                fprintf(out, " %s", in->func);
+            else
+                fprintf(out, " #%d", in->aux);
+            for (int i = 0; i < in->argc; i++) {
+                fprintf(out, i ? ", " : " ");
+                dump_operand(out, fn, in->args[i]);
+            }
+            break;
+        case IR_IS:
+            fprintf(out, " ");
+            dump_operand(out, fn, in->a);
+            fprintf(out, " mask %d", in->aux);
+            break;
+        default:
+            if (in->a.kind != IR_OPD_NONE) {
+                fprintf(out, " ");
+                dump_operand(out, fn, in->a);
+            }
+            if (in->b.kind != IR_OPD_NONE) {
+                fprintf(out, ", ");
+                dump_operand(out, fn, in->b);
+            }
+            break;
+    }
+    fprintf(out, "\n");
+}
+
+void ir_dump(FILE *out, const IRProgram *prog)
+{
+    for (int g = 0; g < prog->global_count; g++)
+        fprintf(out, "global @%s\n", prog->globals[g]);
+
+    for (int f = 0; f < prog->func_count; f++) {
+        const IRFunc *fn = prog->funcs[f];
+
+        // LF@ variables the code generator defines for locals and temps
+        int *slot = ir_assign_slots(fn, NULL);
+        int slots = 0;
+        for (int v = fn->param_count; v < fn->var_count; v++)
+            slots += slot[v] == v;
+        free(slot);
+
+        fprintf(out, "\nfunc %s (%d params, %d vars, %d slots)\n",
+                fn->name, fn->param_count, fn->var_count, slots);
+
+        for (int b = 0; b < fn->block_count; b++) {
+            const IRBlock *bb = fn->blocks[b];
+            fprintf(out, "  b%d:\n", bb->id);
+            for (int i = 0; i < bb->count; i++)
+                dump_instr(out, fn, &bb->code[i]);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "ast.h"
+#include "symtable.h"
+
+/* ---------------------------------------------------------
+   Intermediate representation
+   A function is a list of basic blocks of three-address
+   instructions over virtual registers (IRVar). Parameters,
+   source locals and expression temporaries all live in the
+   same per-function var table; locals and temporaries are
+   defined once in the function prologue. Each block ends in
+   exactly one terminator (JUMP, BRANCH or RETURN).
+   --------------------------------------------------------- */
+
+typedef enum {
+    IR_OPD_NONE,
+    IR_OPD_VAR,       // var: index into IRFunc.vars
+    IR_OPD_GLOBAL,    // name: GF@name
+    IR_OPD_INT,
+    IR_OPD_FLOAT,
+    IR_OPD_STRING,    // name: interned contents
+    IR_OPD_BOOL,
+    IR_OPD_NIL
+} IROperandKind;
+
+typedef struct {
+    IROperandKind kind;
+    TypeMask      mask;   // VAR / GLOBAL: type proven at this use, 0 = unknown
+    union {
+        int         var;
+        long long   i;
+        double      f;
+        bool        b;
+        const char *name;
+    } u;
+} IROperand;
+
+typedef enum {
+    IR_MOVE,        // dst = a
+
+    // Num/String operators, semantics of the source language
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV,
+    IR_LT, IR_GT, IR_LE, IR_GE, IR_EQ, IR_NE,
+    IR_IS,          // dst = a is <aux TYPEMASK_*>
+
+    IR_CALL,        // dst = func(args...)  user function, getter or setter
+    IR_BUILTIN,     // dst = Ifj.<aux BuiltinId>(args...)
+
+    // terminators
+    IR_JUMP,        // goto target[0]
+    IR_BRANCH,      // a truthy ? target[0] : target[1]
+    IR_RETURN       // return a
+} IROp;
+
+typedef struct {
+    IROp       op;
+    IROperand  dst;
+    IROperand  a;
+    IROperand  b;
+    int        aux;        // IR_IS type mask, IR_BUILTIN id
+    int        target[2];  // block ids of JUMP / BRANCH
+    const char *func;      // IR_CALL: symtable key, e.g. "main$0"
+    IROperand  *args;      // IR_CALL / IR_BUILTIN
+    int         argc;
+} IRInstr;
+
+typedef enum {
+    IR_VAR_PARAM,
+    IR_VAR_LOCAL,
+    IR_VAR_TEMP
+} IRVarKind;
+
+typedef struct {
+    IRVarKind   kind;
+    const char *name;       // source name, NULL for temporaries
+    int         index;      // parameter position / per-kind number
+    TypeMask    type_mask;
+} IRVar;
+
+typedef struct {
+    int      id;
+    IRInstr *code;
+    int      count;
+    int      cap;
+} IRBlock;
+
+typedef struct {
+    const char *name;       // symtable key: name$arity / name$get / name$set
+    int         param_count;
+    IRVar      *vars;
+    int         var_count;
+    int         var_cap;
+    int         kind_count[3]; // next IRVar.index per IRVarKind
+    IRBlock   **blocks;     // layout order, blocks[0] is the entry
+    int         block_count;
+    int         block_cap;
+} IRFunc;
+
+typedef struct {
+    IRFunc    **funcs;
+    int         func_count;
+    int         func_cap;
+    const char **globals;   // GF variables, all start as null
+    int         global_count;
+    int         global_cap;
+} IRProgram;
+
+/* Construction */
+IRProgram *ir_program_new(void);
+void       ir_program_free(IRProgram *prog);
+IRFunc    *ir_func_new(IRProgram *prog, const char *name, int param_count);
+void       ir_func_free(IRFunc *fn);       // does not unlink it from the program
+void       ir_add_global(IRProgram *prog, const char *name);
+
+int        ir_new_var(IRFunc *fn, IRVarKind kind, const char *name, TypeMask mask);
+IRBlock   *ir_new_block(IRFunc *fn);
+IRInstr   *ir_append(IRBlock *bb, IROp op);
+
+/* Operands */
+IROperand  ir_none(void);
+IROperand  ir_var(int var);
+IROperand  ir_global(const char *name);
+IROperand  ir_int(long long v);
+IROperand  ir_float(double v);
+IROperand  ir_string(const char *s);
+IROperand  ir_bool(bool v);
+IROperand  ir_nil(void);
+
+TypeMask   ir_operand_mask(const IRFunc *fn, IROperand o);
+bool       ir_is_terminator(IROp op);
+bool       ir_block_terminated(const IRBlock *bb);
+
+/* Lowering (ir_lower.c): analysed AST → IR */
+IRProgram *ir_lower(ASTNode *root);
+
+/* Optimization passes, ir_optimize runs all of them in order */
+void       ir_optimize(IRProgram *prog);
+void       ir_tail_calls(IRProgram *prog); // ir_tailcall.c
+void       ir_inline(IRProgram *prog);     // ir_inline.c
+void       ir_dead_code(IRProgram *prog);  // ir_dce.c
+void       ir_value_numbering(IRProgram *prog); // ir_lvn.c
+void       ir_hoist_invariants(IRProgram *prog); // ir_licm.c
+
+/* Frame slots (ir_slots.c): per var, the var whose storage it can
+   share; vars marked in `skip` (may be NULL) keep their own */
+int       *ir_assign_slots(const IRFunc *fn, const bool *skip);
+
+/* Debug listing */
+void       ir_dump(FILE *out, const IRProgram *prog);
+
+#endif
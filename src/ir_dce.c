@@ -0,0 +1,355 @@
+// ir_dce.c
+
+#include "ir.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Dead code elimination
+   - branches whose condition is known become jumps
+   - jumps to blocks that only jump again are threaded
+   - blocks not reachable from the entry are dropped, this
+     covers everything after an unconditional return
+   - a block jumping to a block nothing else enters absorbs it
+   - temporaries nobody reads are not computed, as long as
+     computing them can not fail at run time
+   - functions main$0 can not reach are dropped
+   --------------------------------------------------------- */
+
+// value of a constant operand used as a condition
+static bool constant_truth(IROperand o, bool *value)
+{
+    switch (o.kind) {
+        case IR_OPD_BOOL:   *value = o.u.b; return true;
+        case IR_OPD_NIL:    *value = false; return true;
+        case IR_OPD_INT:
+        case IR_OPD_FLOAT:
+        case IR_OPD_STRING: *value = true;  return true;
+        default:            return false;
+    }
+}
+
+// is the branch condition decided before the program runs?
+static bool branch_decided(const IRFunc *fn, const IRBlock *bb, int at, bool *value)
+{
+    IROperand c = bb->code[at].a;
+
+    if (constant_truth(c, value))
+        return true;
+
+    TypeMask mask = ir_operand_mask(fn, c);
+    if (mask == TYPEMASK_NULL) {
+        *value = false;
+        return true;
+    }
+    if (!(mask & (TYPEMASK_NULL | TYPEMASK_BOOL))) {
+        *value = true;
+        return true;
+    }
+
+    // a temporary set right here in the block
+    if (c.kind != IR_OPD_VAR || fn->vars[c.u.var].kind != IR_VAR_TEMP)
+        return false;
+    for (int i = at - 1; i >= 0; i--) {
+        const IRInstr *in = &bb->code[i];
+        if (in->dst.kind != IR_OPD_VAR || in->dst.u.var != c.u.var)
+            continue;
+        if (in->op == IR_MOVE)
+            return constant_truth(in->a, value);
+        if (in->op == IR_IS) {
+            TypeMask m = ir_operand_mask(fn, in->a);
+            if (!(m & ~in->aux) || !(m & in->aux)) {
+                *value = (m & in->aux) != 0;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+static void fold_branches(IRFunc *fn)
+{
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock *bb = fn->blocks[b];
+        if (!bb->count || bb->code[bb->count - 1].op != IR_BRANCH)
+            continue;
+
+        bool value;
+        if (branch_decided(fn, bb, bb->count - 1, &value)) {
+            IRInstr *in = &bb->code[bb->count - 1];
+            in->op = IR_JUMP;
+            in->target[0] = value ? in->target[0] : in->target[1];
+            in->a = ir_none();
+        }
+    }
+}
+
+// final target of `target` when it is a chain of blocks holding only a JUMP
+static int thread_target(const IRFunc *fn, int target)
+{
+    for (int hops = 0; hops < fn->block_count; hops++) {
+        const IRBlock *bb = fn->blocks[target];
+        if (bb->count != 1 || bb->code[0].op != IR_JUMP)
+            break;
+        target = bb->code[0].target[0];
+    }
+    return target;
+}
+
+static void thread_jumps(IRFunc *fn)
+{
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock *bb = fn->blocks[b];
+        if (!bb->count)
+            continue;
+        IRInstr *in = &bb->code[bb->count - 1];
+        if (in->op == IR_JUMP)
+            in->target[0] = thread_target(fn, in->target[0]);
+        else if (in->op == IR_BRANCH) {
+            in->target[0] = thread_target(fn, in->target[0]);
+            in->target[1] = thread_target(fn, in->target[1]);
+        }
+    }
+}
+
+static void mark_reachable(const IRFunc *fn, int b, bool *seen)
+{
+    // explicit worklist, long if/else chains would nest deeply
+    int *work = malloc((size_t)fn->block_count * sizeof(int));
+    if (!work)
+        error_exit(99, "Out of memory (dead code)\n");
+    int top = 0;
+
+    seen[b] = true;
+    work[top++] = b;
+    while (top > 0) {
+        const IRBlock *bb = fn->blocks[work[--top]];
+        const IRInstr *in = bb->count ? &bb->code[bb->count - 1] : NULL;
+        int n = !in ? 0 : in->op == IR_JUMP ? 1 : in->op == IR_BRANCH ? 2 : 0;
+        for (int i = 0; i < n; i++) {
+            if (!seen[in->target[i]]) {
+                seen[in->target[i]] = true;
+                work[top++] = in->target[i];
+            }
+        }
+    }
+    free(work);
+}
+
+static void free_block(IRBlock *bb)
+{
+    for (int i = 0; i < bb->count; i++)
+        free(bb->code[i].args);
+    free(bb->code);
+    free(bb);
+}
+
+// keeps the layout order of the remaining blocks, renumbers them
+static void remove_unreachable(IRFunc *fn)
+{
+    bool *seen = calloc((size_t)fn->block_count, sizeof(bool));
+    int *new_id = malloc((size_t)fn->block_count * sizeof(int));
+    if (!seen || !new_id)
+        error_exit(99, "Out of memory (dead code)\n");
+
+    mark_reachable(fn, 0, seen);
+
+    int count = 0;
+    for (int b = 0; b < fn->block_count; b++) {
+        if (seen[b]) {
+            new_id[b] = count;
+            fn->blocks[count] = fn->blocks[b];
+            fn->blocks[count]->id = count;
+            count++;
+        } else {
+            new_id[b] = -1;
+            free_block(fn->blocks[b]);
+        }
+    }
+    fn->block_count = count;
+
+    for (int b = 0; b < count; b++) {
+        IRBlock *bb = fn->blocks[b];
+        if (!bb->count)
+            continue;
+        IRInstr *in = &bb->code[bb->count - 1];
+        if (in->op == IR_JUMP || in->op == IR_BRANCH) {
+            in->target[0] = new_id[in->target[0]];
+            if (in->op == IR_BRANCH)
+                in->target[1] = new_id[in->target[1]];
+        }
+    }
+
+    free(new_id);
+    free(seen);
+}
+
+// A: ..; jump B  with A the only way into B  →  A: ..; <B's code>
+static void merge_blocks(IRFunc *fn)
+{
+    int *preds = calloc((size_t)fn->block_count, sizeof(int));
+    if (!preds)
+        error_exit(99, "Out of memory (dead code)\n");
+
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        const IRInstr *in = bb->count ? &bb->code[bb->count - 1] : NULL;
+        if (in && in->op == IR_JUMP)
+            preds[in->target[0]]++;
+        else if (in && in->op == IR_BRANCH) {
+            preds[in->target[0]]++;
+            preds[in->target[1]]++;
+        }
+    }
+
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock *bb = fn->blocks[b];
+        while (bb->count && bb->code[bb->count - 1].op == IR_JUMP) {
+            int t = bb->code[bb->count - 1].target[0];
+            IRBlock *next = fn->blocks[t];
+            if (t == 0 || t == b || preds[t] != 1 || !next->count)
+                break;
+
+            bb->count--;
+            for (int i = 0; i < next->count; i++)
+                *ir_append(bb, next->code[i].op) = next->code[i];
+            // `next` is now unreachable, remove_unreachable frees it
+            next->count = 0;
+            preds[t] = 0;
+        }
+    }
+    free(preds);
+}
+
+// no run-time error possible, so an unused result need not be computed
+static bool removable(const IRFunc *fn, const IRInstr *in)
+{
+    TypeMask a = ir_operand_mask(fn, in->a), b = ir_operand_mask(fn, in->b);
+    bool nums = (a == TYPEMASK_INT || a == TYPEMASK_FLOAT) &&
+                (b == TYPEMASK_INT || b == TYPEMASK_FLOAT);
+
+    switch (in->op) {
+        case IR_MOVE: case IR_IS: case IR_EQ: case IR_NE:
+            return true;
+        case IR_ADD: case IR_SUB: case IR_MUL:
+        case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            return nums;
+        default:
+            return false;   // DIV by zero, calls and builtins have effects
+    }
+}
+
+static void count_use(int *uses, IROperand o)
+{
+    if (o.kind == IR_OPD_VAR)
+        uses[o.u.var]++;
+}
+
+static void remove_unused_temps(IRFunc *fn)
+{
+    int *uses = malloc(((size_t)fn->var_count + 1) * sizeof(int));
+    if (!uses)
+        error_exit(99, "Out of memory (dead code)\n");
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        memset(uses, 0, ((size_t)fn->var_count + 1) * sizeof(int));
+        for (int b = 0; b < fn->block_count; b++) {
+            const IRBlock *bb = fn->blocks[b];
+            for (int i = 0; i < bb->count; i++) {
+                count_use(uses, bb->code[i].a);
+                count_use(uses, bb->code[i].b);
+                for (int j = 0; j < bb->code[i].argc; j++)
+                    count_use(uses, bb->code[i].args[j]);
+            }
+        }
+
+        for (int b = 0; b < fn->block_count; b++) {
+            IRBlock *bb = fn->blocks[b];
+            int n = 0;
+            for (int i = 0; i < bb->count; i++) {
+                IRInstr *in = &bb->code[i];
+                if (in->dst.kind == IR_OPD_VAR && fn->vars[in->dst.u.var].kind == IR_VAR_TEMP &&
+                    uses[in->dst.u.var] == 0 && removable(fn, in)) {
+                    free(in->args);
+                    changed = true;
+                    continue;
+                }
+                bb->code[n++] = *in;
+            }
+            bb->count = n;
+        }
+    }
+    free(uses);
+}
+
+/* ---------------------------------------------------------
+   Unreachable functions
+   --------------------------------------------------------- */
+
+static int func_index(const IRProgram *prog, const char *name)
+{
+    for (int i = 0; i < prog->func_count; i++)
+        if (prog->funcs[i]->name == name || strcmp(prog->funcs[i]->name, name) == 0)
+            return i;
+    return -1;
+}
+
+static void remove_unreachable_funcs(IRProgram *prog)
+{
+    int entry = func_index(prog, "main$0");
+    if (entry < 0)
+        return;
+
+    int n = prog->func_count;
+    bool *live = calloc((size_t)n, sizeof(bool));
+    int *work = malloc((size_t)n * sizeof(int));
+    if (!live || !work)
+        error_exit(99, "Out of memory (dead code)\n");
+
+    int top = 0;
+    live[entry] = true;
+    work[top++] = entry;
+    while (top > 0) {
+        const IRFunc *fn = prog->funcs[work[--top]];
+        for (int b = 0; b < fn->block_count; b++)
+            for (int i = 0; i < fn->blocks[b]->count; i++) {
+                const IRInstr *in = &fn->blocks[b]->code[i];
+                int g = in->op == IR_CALL ? func_index(prog, in->func) : -1;
+                if (g >= 0 && !live[g]) {
+                    live[g] = true;
+                    work[top++] = g;
+                }
+            }
+    }
+
+    int count = 0;
+    for (int f = 0; f < n; f++) {
+        if (live[f])
+            prog->funcs[count++] = prog->funcs[f];
+        else
+            ir_func_free(prog->funcs[f]);
+    }
+    prog->func_count = count;
+
+    free(work);
+    free(live);
+}
+
+void ir_dead_code(IRProgram *prog)
+{
+    for (int f = 0; f < prog->func_count; f++) {
+        IRFunc *fn = prog->funcs[f];
+        fold_branches(fn);
+        thread_jumps(fn);
+        remove_unreachable(fn);
+        merge_blocks(fn);           // counts predecessors, dead ones must be gone
+        remove_unreachable(fn);
+        remove_unused_temps(fn);
+    }
+    remove_unreachable_funcs(prog);
+}
@@ -0,0 +1,214 @@
+// ir_inline.c
+
+#include "ir.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Inlining
+   Calls to small straight-line functions (getters, setters
+   and one-line static functions) are replaced by a copy of
+   the callee's body. The callee's parameters, locals and
+   temporaries become fresh vars of the caller, so names can
+   not clash. Recursive functions are never inlined.
+   --------------------------------------------------------- */
+
+#define INLINE_MAX_INSTRS 8     // callee body size, RETURN included
+
+typedef struct {
+    IRProgram *prog;
+    bool      *recursive;       // per function: can reach itself through calls
+} Inliner;
+
+static int find_func(const IRProgram *prog, const char *name)
+{
+    for (int i = 0; i < prog->func_count; i++)
+        if (prog->funcs[i]->name == name || strcmp(prog->funcs[i]->name, name) == 0)
+            return i;
+    return -1;
+}
+
+// call graph: calls[f * n + g] when f calls g
+static bool *call_graph(const IRProgram *prog)
+{
+    int n = prog->func_count;
+    bool *calls = calloc((size_t)n * (size_t)n + 1, sizeof(bool));
+    if (!calls)
+        error_exit(99, "Out of memory (inliner)\n");
+
+    for (int f = 0; f < n; f++) {
+        const IRFunc *fn = prog->funcs[f];
+        for (int b = 0; b < fn->block_count; b++)
+            for (int i = 0; i < fn->blocks[b]->count; i++) {
+                const IRInstr *in = &fn->blocks[b]->code[i];
+                int g = in->op == IR_CALL ? find_func(prog, in->func) : -1;
+                if (g >= 0)
+                    calls[f * n + g] = true;
+            }
+    }
+    return calls;
+}
+
+static bool *find_recursive(const IRProgram *prog)
+{
+    int n = prog->func_count;
+    bool *reach = call_graph(prog);
+
+    // transitive closure, programs have few functions
+    for (int k = 0; k < n; k++)
+        for (int i = 0; i < n; i++)
+            if (reach[i * n + k])
+                for (int j = 0; j < n; j++)
+                    if (reach[k * n + j])
+                        reach[i * n + j] = true;
+
+    bool *recursive = calloc((size_t)n + 1, sizeof(bool));
+    if (!recursive)
+        error_exit(99, "Out of memory (inliner)\n");
+    for (int i = 0; i < n; i++)
+        recursive[i] = reach[i * n + i];
+    free(reach);
+    return recursive;
+}
+
+// entry block ends in RETURN: nothing else of the body can run
+static bool inlinable(const Inliner *inl, int callee)
+{
+    const IRFunc *fn = inl->prog->funcs[callee];
+    const IRBlock *entry = fn->blocks[0];
+
+    return !inl->recursive[callee] &&
+           entry->count <= INLINE_MAX_INSTRS &&
+           entry->count > 0 && entry->code[entry->count - 1].op == IR_RETURN;
+}
+
+static bool assigned(const IRBlock *bb, int var)
+{
+    for (int i = 0; i < bb->count; i++)
+        if (bb->code[i].dst.kind == IR_OPD_VAR && bb->code[i].dst.u.var == var)
+            return true;
+    return false;
+}
+
+static IROperand remap(IROperand o, const IROperand *map)
+{
+    if (o.kind != IR_OPD_VAR)
+        return o;
+
+    IROperand r = map[o.u.var];
+    // keep what the analysis proved at this use, if anything
+    if (r.kind == IR_OPD_VAR || r.kind == IR_OPD_GLOBAL)
+        r.mask = o.mask ? o.mask : r.mask;
+    return r;
+}
+
+// replaces bb->code[at] (an IR_CALL of `callee`) by the callee's body
+static void inline_call(IRFunc *caller, IRBlock *bb, int at, const IRFunc *callee)
+{
+    const IRBlock *body = callee->blocks[0];
+    IRInstr call = bb->code[at];
+    const IRInstr *ret = &body->code[body->count - 1];
+
+    IROperand *map = calloc((size_t)callee->var_count + 1, sizeof(IROperand));
+    IRInstr *code = calloc((size_t)(callee->param_count + body->count) + 1, sizeof(IRInstr));
+    if (!map || !code)
+        error_exit(99, "Out of memory (inliner)\n");
+    int n = 0;
+
+    for (int v = 0; v < callee->var_count; v++) {
+        const IRVar *cv = &callee->vars[v];
+
+        if (cv->kind == IR_VAR_PARAM) {
+            IROperand arg = call.args[cv->index];
+            // read-only parameter: use the argument itself, a global
+            // could be changed by the body before it is read
+            if (!assigned(body, v) && arg.kind != IR_OPD_GLOBAL) {
+                map[v] = arg;
+                continue;
+            }
+            // a local, not a temporary: the body assigns it again
+            map[v] = ir_var(ir_new_var(caller, IR_VAR_LOCAL, "arg", cv->type_mask));
+            code[n].op = IR_MOVE;
+            code[n].dst = map[v];
+            code[n].a = arg;
+            n++;
+        } else if (cv->kind == IR_VAR_TEMP && call.dst.kind == IR_OPD_VAR &&
+                   ret->a.kind == IR_OPD_VAR && ret->a.u.var == v) {
+            // the returned temporary is computed straight into the result
+            map[v] = call.dst;
+        } else {
+            map[v] = ir_var(ir_new_var(caller, cv->kind, cv->name, cv->type_mask));
+        }
+    }
+
+    for (int i = 0; i < body->count - 1; i++) {
+        IRInstr in = body->code[i];
+        in.dst = remap(in.dst, map);
+        in.a = remap(in.a, map);
+        in.b = remap(in.b, map);
+        if (in.argc > 0) {
+            IROperand *args = malloc((size_t)in.argc * sizeof(IROperand));
+            if (!args)
+                error_exit(99, "Out of memory (inliner)\n");
+            for (int j = 0; j < in.argc; j++)
+                args[j] = remap(body->code[i].args[j], map);
+            in.args = args;
+        }
+        code[n++] = in;
+    }
+
+    if (call.dst.kind != IR_OPD_NONE) {
+        IROperand value = remap(ret->a, map);
+        if (!(value.kind == call.dst.kind && value.kind == IR_OPD_VAR &&
+              value.u.var == call.dst.u.var)) {
+            code[n].op = IR_MOVE;
+            code[n].dst = call.dst;
+            code[n].a = value;
+            n++;
+        }
+    }
+
+    // splice: bb->code[at] is replaced by code[0..n)
+    int count = bb->count - 1 + n;
+    if (count > bb->cap) {
+        IRInstr *grown = realloc(bb->code, (size_t)count * sizeof(IRInstr));
+        if (!grown)
+            error_exit(99, "Out of memory (inliner)\n");
+        bb->code = grown;
+        bb->cap = count;
+    }
+    memmove(&bb->code[at + n], &bb->code[at + 1],
+            (size_t)(bb->count - at - 1) * sizeof(IRInstr));
+    memcpy(&bb->code[at], code, (size_t)n * sizeof(IRInstr));
+    bb->count = count;
+
+    free(call.args);
+    free(code);
+    free(map);
+}
+
+void ir_inline(IRProgram *prog)
+{
+    Inliner inl = { .prog = prog, .recursive = find_recursive(prog) };
+
+    for (int f = 0; f < prog->func_count; f++) {
+        IRFunc *fn = prog->funcs[f];
+        for (int b = 0; b < fn->block_count; b++) {
+            IRBlock *bb = fn->blocks[b];
+            // inserted code is scanned again, calls in it may inline too;
+            // the call graph below a non-recursive callee is acyclic
+            for (int i = 0; i < bb->count; ) {
+                IRInstr *in = &bb->code[i];
+                int callee = in->op == IR_CALL ? find_func(prog, in->func) : -1;
+                if (callee < 0 || callee == f || !inlinable(&inl, callee))
+                    i++;
+                else
+                    inline_call(fn, bb, i, prog->funcs[callee]);
+            }
+        }
+    }
+
+    free(inl.recursive);
+}
@@ -0,0 +1,222 @@
+// ir_licm.c
+
+#include "ir.h"
+#include "builtin.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Loop-invariant code motion
+   Loops come from `while`: the blocks between a backward jump
+   and its target, with the target as header. A temporary
+   computed in the loop from values the loop never changes is
+   computed once in the preheader instead, the one block
+   outside the loop that jumps to the header.
+   Only instructions that can not fail are moved, so running
+   them when the loop body would not have run is harmless.
+   --------------------------------------------------------- */
+
+// argument types for which a builtin has no effect and no error
+static const TypeMask pure_builtin_args[][3] = {
+    [BI_FLOOR]     = { TYPEMASK_NUM },
+    [BI_STR]       = { TYPEMASK_ALL },
+    [BI_LENGTH]    = { TYPEMASK_STRING },
+    [BI_SUBSTRING] = { TYPEMASK_STRING, TYPEMASK_INT, TYPEMASK_INT },
+    [BI_STRCMP]    = { TYPEMASK_STRING, TYPEMASK_STRING },
+    [BI_ORD]       = { TYPEMASK_STRING, TYPEMASK_INT },
+    [BI_CHR]       = { 0 },     // INT2CHAR fails outside 0..255, see below
+};
+
+typedef struct {
+    IRFunc *fn;
+    int     head, last;     // loop blocks head .. last in layout order
+    bool   *defined;        // per var: assigned somewhere in the loop
+    bool    globals_stable; // no call and no global assignment in the loop
+} Loop;
+
+static bool is_exact_num(TypeMask m)
+{
+    return m == TYPEMASK_INT || m == TYPEMASK_FLOAT;
+}
+
+static bool invariant(const Loop *lp, IROperand o)
+{
+    switch (o.kind) {
+        case IR_OPD_VAR:    return !lp->defined[o.u.var];
+        case IR_OPD_GLOBAL: return lp->globals_stable;
+        default:            return true;
+    }
+}
+
+static bool pure_builtin(const IRFunc *fn, const IRInstr *in)
+{
+    if (in->aux == BI_CHR) {
+        const IROperand *c = &in->args[0];
+        return c->kind == IR_OPD_INT && c->u.i >= 0 && c->u.i <= 255;
+    }
+    if (in->aux < BI_FLOOR || in->aux > BI_CHR)
+        return false;   // read_* and write have effects
+
+    for (int i = 0; i < in->argc && i < 3; i++) {
+        TypeMask m = ir_operand_mask(fn, in->args[i]);
+        if (m & ~pure_builtin_args[in->aux][i])
+            return false;
+    }
+    return true;
+}
+
+// can `in` be computed anywhere, any number of times?
+static bool movable(const Loop *lp, const IRInstr *in)
+{
+    const IRFunc *fn = lp->fn;
+
+    if (in->dst.kind != IR_OPD_VAR || fn->vars[in->dst.u.var].kind != IR_VAR_TEMP)
+        return false;
+
+    TypeMask a = ir_operand_mask(fn, in->a), b = ir_operand_mask(fn, in->b);
+    switch (in->op) {
+        case IR_MOVE: case IR_IS: case IR_EQ: case IR_NE:
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL:
+        case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            if (!is_exact_num(a) || !is_exact_num(b))
+                return false;   // a type error must stay where it was
+            break;
+        case IR_BUILTIN:
+            if (!pure_builtin(fn, in))
+                return false;
+            for (int i = 0; i < in->argc; i++)
+                if (!invariant(lp, in->args[i]))
+                    return false;
+            return true;
+        default:
+            return false;   // DIV by zero, calls
+    }
+    return invariant(lp, in->a) && invariant(lp, in->b);
+}
+
+static void scan_loop(Loop *lp)
+{
+    memset(lp->defined, 0, (size_t)lp->fn->var_count * sizeof(bool));
+    lp->globals_stable = true;
+
+    for (int b = lp->head; b <= lp->last; b++) {
+        const IRBlock *bb = lp->fn->blocks[b];
+        for (int i = 0; i < bb->count; i++) {
+            const IRInstr *in = &bb->code[i];
+            if (in->dst.kind == IR_OPD_VAR)
+                lp->defined[in->dst.u.var] = true;
+            if (in->dst.kind == IR_OPD_GLOBAL || in->op == IR_CALL)
+                lp->globals_stable = false;
+        }
+    }
+}
+
+// the only block outside the loop entering the header, if it ends in a JUMP
+static IRBlock *preheader(const Loop *lp)
+{
+    IRBlock *pre = NULL;
+
+    for (int b = 0; b < lp->fn->block_count; b++) {
+        if (b >= lp->head && b <= lp->last)
+            continue;
+        IRBlock *bb = lp->fn->blocks[b];
+        if (!bb->count)
+            continue;
+        const IRInstr *in = &bb->code[bb->count - 1];
+        bool enters = (in->op == IR_JUMP && in->target[0] == lp->head) ||
+                      (in->op == IR_BRANCH &&
+                       (in->target[0] == lp->head || in->target[1] == lp->head));
+        if (!enters)
+            continue;
+        if (pre || in->op != IR_JUMP)
+            return NULL;
+        pre = bb;
+    }
+    return pre;
+}
+
+// moves `in` to the end of `pre`, in front of its JUMP
+static void hoist(IRBlock *pre, const IRInstr *in)
+{
+    IRInstr jump = pre->code[pre->count - 1];
+    pre->code[pre->count - 1] = *in;
+    *ir_append(pre, IR_JUMP) = jump;
+}
+
+static void licm_loop(Loop *lp)
+{
+    IRBlock *pre = preheader(lp);
+    if (!pre)
+        return;
+
+    scan_loop(lp);
+
+    // moving a definition out can make its users invariant too
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = lp->head; b <= lp->last; b++) {
+            IRBlock *bb = lp->fn->blocks[b];
+            int n = 0;
+            for (int i = 0; i < bb->count; i++) {
+                IRInstr *in = &bb->code[i];
+                if (movable(lp, in)) {
+                    hoist(pre, in);
+                    lp->defined[in->dst.u.var] = false;
+                    changed = true;
+                    continue;
+                }
+                bb->code[n++] = *in;
+            }
+            bb->count = n;
+        }
+    }
+}
+
+static int by_size(const void *x, const void *y)
+{
+    const int *a = x, *b = y;
+    return (a[1] - a[0]) - (b[1] - b[0]);
+}
+
+void ir_hoist_invariants(IRProgram *prog)
+{
+    for (int f = 0; f < prog->func_count; f++) {
+        IRFunc *fn = prog->funcs[f];
+
+        // (head, last) per backward jump, inner loops first
+        int *loops = malloc(((size_t)fn->block_count * 2 + 2) * 2 * sizeof(int));
+        bool *defined = malloc((size_t)fn->var_count + 1);
+        if (!loops || !defined)
+            error_exit(99, "Out of memory (loop motion)\n");
+        int count = 0;
+
+        for (int b = 0; b < fn->block_count; b++) {
+            const IRBlock *bb = fn->blocks[b];
+            if (!bb->count)
+                continue;
+            const IRInstr *in = &bb->code[bb->count - 1];
+            int n = in->op == IR_JUMP ? 1 : in->op == IR_BRANCH ? 2 : 0;
+            for (int t = 0; t < n; t++) {
+                if (in->target[t] <= b) {
+                    loops[count * 2] = in->target[t];
+                    loops[count * 2 + 1] = b;
+                    count++;
+                }
+            }
+        }
+        qsort(loops, (size_t)count, 2 * sizeof(int), by_size);
+
+        for (int l = 0; l < count; l++) {
+            Loop lp = { .fn = fn, .head = loops[l * 2], .last = loops[l * 2 + 1],
+                        .defined = defined };
+            licm_loop(&lp);
+        }
+
+        free(defined);
+        free(loops);
+    }
+}
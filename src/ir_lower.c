@@ -0,0 +1,498 @@
+// ir_lower.c
+//
+// Lowers the analysed AST into the IR of ir.h. Names are resolved
+// the same way the semantic pass does: block locals first, then
+// global variables, then getters / setters of the same name.
+
+#include "ir.h"
+#include "symtable.h"
+#include "builtin.h"
+#include "token.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+extern SymTable *g_global_symtable;
+
+typedef struct {
+    IRProgram *prog;
+    IRFunc    *fn;
+    IRBlock   *bb;          // block being appended to
+    ScopeStack scopes;      // locals of the current function
+} Lowering;
+
+static Lowering lw;
+
+static IROperand lower_expr(ASTNode *node);
+static void      lower_block(ASTNode *block);
+
+/* ---------------------------------------------------------
+   Helpers
+   --------------------------------------------------------- */
+
+static TypeMask node_mask(const ASTNode *node)
+{
+    return node->type_mask ? node->type_mask : TYPEMASK_ALL;
+}
+
+static IROperand new_temp(TypeMask mask)
+{
+    return ir_var(ir_new_var(lw.fn, IR_VAR_TEMP, NULL, mask));
+}
+
+static IRInstr *append(IROp op)
+{
+    return ir_append(lw.bb, op);
+}
+
+// ends the current block with a jump and continues in `next`
+static void jump_to(IRBlock *next)
+{
+    if (!ir_block_terminated(lw.bb))
+        append(IR_JUMP)->target[0] = next->id;
+    lw.bb = next;
+}
+
+static int declare_local(const char *name, int var)
+{
+    SymInfo *sym = calloc(1, sizeof(SymInfo));
+    if (!sym)
+        error_exit(99, "Out of memory (IR local)\n");
+    sym->kind = SYM_VAR;
+    sym->info.var.type_mask = TYPEMASK_ALL;
+    sym->info.var.slot = var;
+
+    if (!scope_declare(&lw.scopes, name, sym))
+        error_exit(99, "Internal: duplicate local '%s' in lowering\n", name);
+    return var;
+}
+
+// variable operand for `name`, IR_OPD_NONE if it is not a variable
+static IROperand lookup_var(const char *name)
+{
+    SymInfo *s = scope_find(&lw.scopes, name);
+    if (s)
+        return ir_var(s->info.var.slot);
+
+    SymInfo *g = symtable_find_local(g_global_symtable, name);
+    if (g && g->kind == SYM_VAR)
+        return ir_global(name);
+
+    return ir_none();
+}
+
+/* ---------------------------------------------------------
+   Expressions
+   --------------------------------------------------------- */
+
+static IROperand lower_literal(const Token *tok)
+{
+    switch (tok->type) {
+        case TOK_INT:    return ir_int(strtoll(tok->lexeme, NULL, 10));
+        case TOK_HEX:    return ir_int(strtoll(tok->lexeme, NULL, 16));
+        case TOK_FLOAT:  return ir_float(strtod(tok->lexeme, NULL));
+        case TOK_STRING: return ir_string(tok->lexeme);
+        case TOK_BOOL:   return ir_bool(tok->lexeme[0] == 't');
+        case TOK_KEYWORD:
+            if (tok->keyword == KW_NULL)
+                return ir_nil();
+            break;
+        default:
+            break;
+    }
+    error_exit(99, "Internal: unexpected literal '%s'\n",
+               tok->lexeme ? tok->lexeme : "");
+    return ir_none();
+}
+
+static IROp binary_op(const Token *tok)
+{
+    switch (tok->type) {
+        case TOK_PLUS:  return IR_ADD;
+        case TOK_MINUS: return IR_SUB;
+        case TOK_STAR:  return IR_MUL;
+        case TOK_SLASH: return IR_DIV;
+        case TOK_LT:    return IR_LT;
+        case TOK_GT:    return IR_GT;
+        case TOK_LE:    return IR_LE;
+        case TOK_GE:    return IR_GE;
+        case TOK_EQ:    return IR_EQ;
+        case TOK_NE:    return IR_NE;
+        case TOK_KEYWORD:
+            if (tok->keyword == KW_IS)
+                return IR_IS;
+            break;
+        default:
+            break;
+    }
+    error_exit(99, "Internal: unknown operator\n");
+    return IR_MOVE;
+}
+
+static TypeMask is_type_mask(const Token *type)
+{
+    switch (type->keyword) {
+        case KW_Num:    return TYPEMASK_NUM;
+        case KW_String: return TYPEMASK_STRING;
+        case KW_Null:   return TYPEMASK_NULL;
+        default:
+            error_exit(2, "Syntax error: 'is' expects Num, String or Null\n");
+    }
+    return 0;
+}
+
+static IROperand lower_binary(ASTNode *node)
+{
+    IROp op = binary_op(node->token);
+    IRInstr *in;
+
+    if (op == IR_IS) {
+        IROperand a = lower_expr(node->children[0]);
+        in = append(IR_IS);
+        in->a = a;
+        in->aux = is_type_mask(node->children[1]->token);
+        in->dst = new_temp(TYPEMASK_BOOL);
+        return in->dst;
+    }
+
+    IROperand a = lower_expr(node->children[0]);
+    IROperand b = lower_expr(node->children[1]);
+
+    TypeMask mask = (op >= IR_LT) ? TYPEMASK_BOOL : node_mask(node);
+    in = append(op);
+    in->a = a;
+    in->b = b;
+    in->dst = new_temp(mask);
+    return in->dst;
+}
+
+static IROperand *lower_args(ASTNode *call, int first, int *argc)
+{
+    *argc = call->child_count - first;
+    if (*argc == 0)
+        return NULL;
+
+    IROperand *args = malloc(sizeof(IROperand) * (size_t)*argc);
+    if (!args)
+        error_exit(99, "Out of memory (IR args)\n");
+    for (int i = 0; i < *argc; i++)
+        args[i] = lower_expr(call->children[first + i]);
+    return args;
+}
+
+static IROperand lower_call(ASTNode *call)
+{
+    int argc;
+
+    if (!call->token) {
+        // Ifj.name(args): child 0 is the AST_FUNC_NAME
+        const char *name = builtin_extract_name(call->children[0]);
+        const BuiltinInfo *b = builtin_lookup(name, call->child_count - 1);
+        if (!b)
+            error_exit(99, "Internal: unknown builtin '%s'\n", name ? name : "");
+
+        IROperand *args = lower_args(call, 1, &argc);
+        IRInstr *in = append(IR_BUILTIN);
+        in->aux = b->id;
+        in->args = args;
+        in->argc = argc;
+        in->dst = new_temp(b->ret_type ? b->ret_type : TYPEMASK_ALL);
+        return in->dst;
+    }
+
+    IROperand *args = lower_args(call, 0, &argc);
+    IRInstr *in = append(IR_CALL);
+    in->func = make_func_key(call->token->lexeme, argc);
+    in->args = args;
+    in->argc = argc;
+    in->dst = new_temp(node_mask(call));
+    return in->dst;
+}
+
+static IROperand lower_getter(ASTNode *node)
+{
+    IRInstr *in = append(IR_CALL);
+    in->func = make_getter_key(node->token->lexeme);
+    in->dst = new_temp(node_mask(node));
+    return in->dst;
+}
+
+static IROperand lower_expr(ASTNode *node)
+{
+    switch (node->type) {
+        case AST_LITERAL:
+            return lower_literal(node->token);
+
+        case AST_CALL:
+            return lower_call(node);
+
+        case AST_GID:
+        case AST_IDENTIFIER: {
+            const Token *tok = node->token;
+            if (tok->type == TOK_KEYWORD)
+                return lower_literal(tok);
+
+            IROperand v = tok->type == TOK_GID ? ir_global(tok->lexeme)
+                                                : lookup_var(tok->lexeme);
+            if (v.kind == IR_OPD_NONE)
+                return lower_getter(node);
+
+            // the type analysis proves a type per use, not per variable
+            v.mask = node->type_mask;
+            return v;
+        }
+
+        case AST_EXPR:
+            if (node->token && node->child_count == 2)
+                return lower_binary(node);
+            if (!node->token && node->child_count == 1)
+                return lower_expr(node->children[0]);
+            if (node->token && node->child_count == 0)
+                return lower_literal(node->token);
+            break;
+
+        default:
+            break;
+    }
+
+    error_exit(99, "Internal: unexpected expression node %d\n", node->type);
+    return ir_none();
+}
+
+// ends the current block with a branch on `cond`; the targets are
+// filled in by the caller once the successor blocks exist
+static IRInstr *lower_condition(ASTNode *cond)
+{
+    IROperand v = lower_expr(cond);
+
+    IRInstr *in = append(IR_BRANCH);
+    in->a = v;
+    return in;
+}
+
+/* ---------------------------------------------------------
+   Statements
+   --------------------------------------------------------- */
+
+static void lower_var_decl(ASTNode *node)
+{
+    const char *name = node->token->lexeme;
+    IROperand init = ir_nil();
+
+    // initializer is evaluated before the name comes into scope
+    if (node->child_count == 1)
+        init = lower_expr(node->children[0]->children[0]);
+
+    // every local gets its own IRVar (shadowed names included) and is
+    // defined once in the function prologue, the declaration is a MOVE
+    int var = ir_new_var(lw.fn, IR_VAR_LOCAL, name, TYPEMASK_ALL);
+    declare_local(name, var);
+
+    IRInstr *in = append(IR_MOVE);
+    in->dst = ir_var(var);
+    in->a = init;
+}
+
+static void lower_assign(ASTNode *node)
+{
+    const Token *target = node->token;
+    IROperand value = lower_expr(node->children[0]);
+    IROperand dst;
+
+    if (target->type == TOK_GID)
+        dst = ir_global(target->lexeme);
+    else
+        dst = lookup_var(target->lexeme);
+
+    if (dst.kind != IR_OPD_NONE) {
+        IRInstr *in = append(IR_MOVE);
+        in->dst = dst;
+        in->a = value;
+        return;
+    }
+
+    // no variable of that name: `name = value` calls the setter
+    IRInstr *in = append(IR_CALL);
+    in->func = make_setter_key(target->lexeme);
+    in->args = malloc(sizeof(IROperand));
+    if (!in->args)
+        error_exit(99, "Out of memory (IR args)\n");
+    in->args[0] = value;
+    in->argc = 1;
+}
+
+static void lower_return(ASTNode *node)
+{
+    IROperand v = ir_nil();
+    if (node->child_count == 1)
+        v = lower_expr(node->children[0]);
+
+    append(IR_RETURN)->a = v;
+
+    // anything after the return lands in an unreachable block
+    lw.bb = ir_new_block(lw.fn);
+}
+
+// blocks are created in layout order: cond, then, else, join
+static void lower_if(ASTNode *ifnode, ASTNode *elsenode)
+{
+    IRBlock *cond_bb = lw.bb;
+    lower_condition(ifnode->children[0]);
+    int branch = cond_bb->count - 1;
+
+    lw.bb = ir_new_block(lw.fn);
+    cond_bb->code[branch].target[0] = lw.bb->id;
+    lower_block(ifnode->children[1]);
+    IRBlock *then_end = lw.bb;
+
+    lw.bb = ir_new_block(lw.fn);
+    cond_bb->code[branch].target[1] = lw.bb->id;
+    if (elsenode)
+        lower_block(elsenode->children[0]);
+
+    IRBlock *join = ir_new_block(lw.fn);
+    if (!ir_block_terminated(then_end))
+        ir_append(then_end, IR_JUMP)->target[0] = join->id;
+    jump_to(join);
+}
+
+static void lower_while(ASTNode *node)
+{
+    IRBlock *head = ir_new_block(lw.fn);
+
+    jump_to(head);
+    lower_condition(node->children[0]);
+    int branch = lw.bb->count - 1;
+    IRBlock *cond_end = lw.bb;
+
+    lw.bb = ir_new_block(lw.fn);
+    cond_end->code[branch].target[0] = lw.bb->id;
+    lower_block(node->children[1]);
+    if (!ir_block_terminated(lw.bb))
+        append(IR_JUMP)->target[0] = head->id;
+
+    lw.bb = ir_new_block(lw.fn);
+    cond_end->code[branch].target[1] = lw.bb->id;
+}
+
+static void lower_statement(ASTNode *node)
+{
+    switch (node->type) {
+        case AST_VAR_DECL: lower_var_decl(node); break;
+        case AST_ASSIGN:   lower_assign(node); break;
+        case AST_RETURN:   lower_return(node); break;
+        case AST_WHILE:    lower_while(node); break;
+        case AST_BLOCK:    lower_block(node); break;
+        case AST_IF:       lower_if(node, NULL); break;
+
+        case AST_CALL:
+        case AST_IDENTIFIER:
+        case AST_GID:
+            lower_expr(node);   // value unused
+            break;
+
+        default:
+            error_exit(99, "Internal: unexpected statement node %d\n", node->type);
+    }
+}
+
+static void lower_block(ASTNode *block)
+{
+    scope_enter(&lw.scopes);
+
+    for (int i = 0; i < block->child_count; ++i) {
+        ASTNode *st = block->children[i];
+
+        // the parser places an IF and its ELSE next to each other
+        if (st->type == AST_IF && i + 1 < block->child_count &&
+            block->children[i + 1]->type == AST_ELSE) {
+            lower_if(st, block->children[++i]);
+            continue;
+        }
+        lower_statement(st);
+    }
+
+    scope_leave(&lw.scopes);
+}
+
+/* ---------------------------------------------------------
+   Functions
+   --------------------------------------------------------- */
+
+static void lower_function(const char *key, ASTNode *params, ASTNode *body)
+{
+    int nparams = params ? params->child_count : 0;
+
+    lw.fn = ir_func_new(lw.prog, key, nparams);
+    lw.bb = ir_new_block(lw.fn);
+
+    scope_enter(&lw.scopes);
+    for (int i = 0; i < nparams; ++i) {
+        lw.fn->vars[i].name = params->children[i]->token->lexeme;
+        declare_local(params->children[i]->token->lexeme, i);
+    }
+
+    lower_block(body);
+
+    // falling off the end returns null
+    if (!ir_block_terminated(lw.bb))
+        append(IR_RETURN)->a = ir_nil();
+
+    scope_leave(&lw.scopes);
+}
+
+static void lower_function_def(ASTNode *def)
+{
+    const char *name = def->children[0]->token->lexeme;
+    ASTNode *kind = def->children[1];
+
+    switch (kind->type) {
+        case AST_FUNCTION: {
+            ASTNode *params = kind->children[0];
+            lower_function(make_func_key(name, params->child_count), params, kind->children[1]);
+            break;
+        }
+        case AST_GETTER:
+            lower_function(make_getter_key(name), NULL, kind->children[0]);
+            break;
+        case AST_SETTER: {
+            // children[0] is the single parameter, wrap it as a list
+            ASTNode params = { .type = AST_PARAM_LIST, .children = kind->children,
+                               .child_count = 1 };
+            lower_function(make_setter_key(name), &params, kind->children[1]);
+            break;
+        }
+        default:
+            error_exit(99, "Internal: unknown function kind\n");
+    }
+}
+
+IRProgram *ir_lower(ASTNode *root)
+{
+    memset(&lw, 0, sizeof(lw));
+    lw.prog = ir_program_new();
+    scope_init(&lw.scopes);
+
+    // every global the semantic pass has seen starts out as null
+    SymTable *g = g_global_symtable;
+    for (uint32_t i = 0; i < g->cap; i++) {
+        const SymEntry *e = &g->slots[i];
+        if (e->key && e->sym->kind == SYM_VAR)
+            ir_add_global(lw.prog, e->key);
+    }
+
+    // PROGRAM → CLASS → FUNCTION_S → FUNCTION_DEF*
+    ASTNode *cls = root->children[1];
+    for (int i = 0; i < cls->child_count; ++i) {
+        ASTNode *fs = cls->children[i];
+        if (fs->type != AST_FUNCTION_S)
+            continue;
+        for (int j = 0; j < fs->child_count; ++j)
+            lower_function_def(fs->children[j]);
+    }
+
+    scope_free(&lw.scopes);
+    return lw.prog;
+}
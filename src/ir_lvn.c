@@ -0,0 +1,246 @@
+// ir_lvn.c
+
+#include "ir.h"
+#include "builtin.h"
+#include "err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Local value numbering
+   Inside one basic block, a pure operator applied again to
+   the same values reuses the temporary of the first result.
+   Values are tracked through copies (x = t), and forgotten
+   as soon as one of their inputs is assigned: a local by any
+   instruction writing it, globals by a global assignment or
+   a call.
+   --------------------------------------------------------- */
+
+typedef struct {
+    IROp       op;
+    int        aux;
+    IROperand  a, b;
+    IROperand *args;        // canonical copies, owned
+    int        argc;
+    int        var;         // temporary holding the value
+} Avail;
+
+typedef struct {
+    IRFunc    *fn;
+    Avail     *avail;
+    int        count;
+    int        cap;
+    IROperand *copy_of;     // per var: value it was copied from, NONE if unknown
+    int       *replace;     // per var: temporary it is redundant with, -1 if none
+} LVN;
+
+static bool same_operand(IROperand x, IROperand y)
+{
+    if (x.kind != y.kind)
+        return false;
+    switch (x.kind) {
+        case IR_OPD_VAR:    return x.u.var == y.u.var;
+        case IR_OPD_INT:    return x.u.i == y.u.i;
+        case IR_OPD_FLOAT:  return memcmp(&x.u.f, &y.u.f, sizeof(double)) == 0;
+        case IR_OPD_BOOL:   return x.u.b == y.u.b;
+        case IR_OPD_GLOBAL:
+        case IR_OPD_STRING: return x.u.name == y.u.name || strcmp(x.u.name, y.u.name) == 0;
+        default:            return true;
+    }
+}
+
+static bool reads(IROperand o, int var, bool globals)
+{
+    return (o.kind == IR_OPD_VAR && o.u.var == var) ||
+           (globals && o.kind == IR_OPD_GLOBAL);
+}
+
+static bool avail_reads(const Avail *e, int var, bool globals)
+{
+    if (reads(e->a, var, globals) || reads(e->b, var, globals))
+        return true;
+    for (int i = 0; i < e->argc; i++)
+        if (reads(e->args[i], var, globals))
+            return true;
+    return false;
+}
+
+static IROperand canon(const LVN *lv, IROperand o)
+{
+    if (o.kind == IR_OPD_VAR && lv->copy_of[o.u.var].kind != IR_OPD_NONE)
+        return lv->copy_of[o.u.var];
+    o.mask = 0;
+    return o;
+}
+
+// no side effect, same inputs give the same result (or the same error)
+static bool pure(const IRInstr *in)
+{
+    if (in->op >= IR_ADD && in->op <= IR_IS)
+        return true;
+    return in->op == IR_BUILTIN && in->aux >= BI_FLOOR && in->aux <= BI_CHR;
+}
+
+static bool commutative(const LVN *lv, const IRInstr *in)
+{
+    if (in->op == IR_EQ || in->op == IR_NE)
+        return true;
+    if (in->op != IR_ADD && in->op != IR_MUL)
+        return false;
+    // String + String and String * Num are not
+    TypeMask a = ir_operand_mask(lv->fn, in->a), b = ir_operand_mask(lv->fn, in->b);
+    return !((a | b) & ~TYPEMASK_NUM);
+}
+
+static bool matches(const LVN *lv, const Avail *e, const IRInstr *in,
+                    IROperand a, IROperand b, const IROperand *args)
+{
+    if (e->op != in->op || e->aux != in->aux || e->argc != in->argc)
+        return false;
+    for (int i = 0; i < in->argc; i++)
+        if (!same_operand(e->args[i], args[i]))
+            return false;
+    if (same_operand(e->a, a) && same_operand(e->b, b))
+        return true;
+    return commutative(lv, in) && same_operand(e->a, b) && same_operand(e->b, a);
+}
+
+static void forget(LVN *lv, int var, bool globals)
+{
+    int n = 0;
+    for (int i = 0; i < lv->count; i++) {
+        Avail *e = &lv->avail[i];
+        if (e->var == var || avail_reads(e, var, globals)) {
+            free(e->args);
+            continue;
+        }
+        lv->avail[n++] = *e;
+    }
+    lv->count = n;
+
+    for (int v = 0; v < lv->fn->var_count; v++) {
+        IROperand c = lv->copy_of[v];
+        if (v == var || reads(c, var, globals))
+            lv->copy_of[v] = ir_none();
+    }
+}
+
+static void remember(LVN *lv, const IRInstr *in, IROperand a, IROperand b, const IROperand *args)
+{
+    if (lv->count == lv->cap) {
+        lv->cap = lv->cap ? lv->cap * 2 : 16;
+        lv->avail = realloc(lv->avail, (size_t)lv->cap * sizeof(Avail));
+        if (!lv->avail)
+            error_exit(99, "Out of memory (value numbering)\n");
+    }
+
+    Avail *e = &lv->avail[lv->count++];
+    *e = (Avail){ .op = in->op, .aux = in->aux, .a = a, .b = b,
+                  .argc = in->argc, .var = in->dst.u.var };
+    if (in->argc > 0) {
+        e->args = malloc((size_t)in->argc * sizeof(IROperand));
+        if (!e->args)
+            error_exit(99, "Out of memory (value numbering)\n");
+        memcpy(e->args, args, (size_t)in->argc * sizeof(IROperand));
+    }
+}
+
+static void lvn_block(LVN *lv, IRBlock *bb)
+{
+    for (int i = 0; i < bb->count; i++) {
+        IRInstr *in = &bb->code[i];
+        IROperand a = canon(lv, in->a), b = canon(lv, in->b);
+        IROperand args[4];
+        for (int j = 0; j < in->argc && j < 4; j++)
+            args[j] = canon(lv, in->args[j]);
+
+        bool temp = in->dst.kind == IR_OPD_VAR &&
+                    lv->fn->vars[in->dst.u.var].kind == IR_VAR_TEMP;
+
+        if (temp && pure(in) && in->argc <= 4) {
+            int found = -1;
+            for (int k = 0; k < lv->count && found < 0; k++)
+                if (matches(lv, &lv->avail[k], in, a, b, args))
+                    found = lv->avail[k].var;
+
+            if (found >= 0) {
+                // dst = <same value again>  →  dst = move <first result>
+                free(in->args);
+                in->args = NULL;
+                in->argc = 0;
+                in->op = IR_MOVE;
+                in->aux = 0;
+                in->a = ir_var(found);
+                in->b = ir_none();
+                lv->replace[in->dst.u.var] = found;
+                a = in->a;
+            }
+        }
+
+        // effects of the instruction on what is known
+        if (in->dst.kind == IR_OPD_VAR)
+            forget(lv, in->dst.u.var, false);
+        if (in->dst.kind == IR_OPD_GLOBAL || in->op == IR_CALL)
+            forget(lv, -1, true);
+
+        if (in->dst.kind != IR_OPD_VAR)
+            continue;
+        if (in->op == IR_MOVE && a.kind != IR_OPD_NONE &&
+            !(a.kind == IR_OPD_VAR && a.u.var == in->dst.u.var))
+            lv->copy_of[in->dst.u.var] = a;
+        else if (temp && pure(in) && in->argc <= 4)
+            remember(lv, in, a, b, args);
+    }
+
+    for (int k = 0; k < lv->count; k++)
+        free(lv->avail[k].args);
+    lv->count = 0;
+    for (int v = 0; v < lv->fn->var_count; v++)
+        lv->copy_of[v] = ir_none();
+}
+
+// redundant temporaries are read from the first result instead
+static void use_first_results(const LVN *lv, IROperand *o)
+{
+    if (o->kind != IR_OPD_VAR)
+        return;
+    while (lv->replace[o->u.var] >= 0)
+        o->u.var = lv->replace[o->u.var];
+}
+
+void ir_value_numbering(IRProgram *prog)
+{
+    for (int f = 0; f < prog->func_count; f++) {
+        IRFunc *fn = prog->funcs[f];
+        LVN lv = { .fn = fn };
+        lv.copy_of = calloc((size_t)fn->var_count + 1, sizeof(IROperand));
+        lv.replace = malloc(((size_t)fn->var_count + 1) * sizeof(int));
+        if (!lv.copy_of || !lv.replace)
+            error_exit(99, "Out of memory (value numbering)\n");
+        for (int v = 0; v < fn->var_count; v++)
+            lv.replace[v] = -1;
+
+        for (int b = 0; b < fn->block_count; b++)
+            lvn_block(&lv, fn->blocks[b]);
+
+        // temps are assigned once, the first result dominates every use
+        for (int b = 0; b < fn->block_count; b++) {
+            IRBlock *bb = fn->blocks[b];
+            for (int i = 0; i < bb->count; i++) {
+                IRInstr *in = &bb->code[i];
+                if (in->op == IR_MOVE && in->dst.kind == IR_OPD_VAR &&
+                    lv.replace[in->dst.u.var] >= 0)
+                    continue;   // left for ir_dead_code
+                use_first_results(&lv, &in->a);
+                use_first_results(&lv, &in->b);
+                for (int j = 0; j < in->argc; j++)
+                    use_first_results(&lv, &in->args[j]);
+            }
+        }
+
+        free(lv.avail);
+        free(lv.copy_of);
+        free(lv.replace);
+    }
+}
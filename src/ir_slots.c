@@ -0,0 +1,199 @@
+// ir_slots.c
+
+#include "ir.h"
+#include "err.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Frame slot allocation
+   Locals and temporaries whose values are never needed at
+   the same time share one LF@ variable. Liveness is computed
+   per block and walked backwards per instruction; a var
+   written while another is live interferes with it, and vars
+   that interfere never share a slot.
+   The code generator may expand an instruction into several
+   and write its result before reading every operand, so the
+   result also interferes with the instruction's own operands.
+   A plain MOVE is a single instruction and is exempt, which
+   lets `x = t` reuse the slot of t.
+   --------------------------------------------------------- */
+
+#define SLOT_MAX_VARS 4096      // interference matrix is var_count² bits
+
+typedef uint64_t Word;
+
+typedef struct {
+    const IRFunc *fn;
+    int           words;        // Words per bit set
+    Word         *live_in;      // per block
+    Word         *live_out;     // per block
+    Word         *adj;          // per var: vars it interferes with
+} Slots;
+
+static Word *row(Word *sets, const Slots *s, int i)
+{
+    return &sets[(size_t)i * (size_t)s->words];
+}
+
+static bool test_bit(const Word *set, int v)  { return (set[v / 64] >> (v % 64)) & 1; }
+static void set_bit(Word *set, int v)         { set[v / 64] |= (Word)1 << (v % 64); }
+static void clear_bit(Word *set, int v)       { set[v / 64] &= ~((Word)1 << (v % 64)); }
+
+static void interfere(Slots *s, int a, int b)
+{
+    if (a == b)
+        return;
+    set_bit(row(s->adj, s, a), b);
+    set_bit(row(s->adj, s, b), a);
+}
+
+static void use(Word *live, IROperand o)
+{
+    if (o.kind == IR_OPD_VAR)
+        set_bit(live, o.u.var);
+}
+
+// live before `in`, from what is live after it
+static void step_back(Word *live, const IRInstr *in)
+{
+    if (in->dst.kind == IR_OPD_VAR)
+        clear_bit(live, in->dst.u.var);
+    use(live, in->a);
+    use(live, in->b);
+    for (int j = 0; j < in->argc; j++)
+        use(live, in->args[j]);
+}
+
+static void compute_liveness(Slots *s)
+{
+    const IRFunc *fn = s->fn;
+    Word *live = malloc((size_t)s->words * sizeof(Word));
+    if (!live)
+        error_exit(99, "Out of memory (slot allocation)\n");
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = fn->block_count - 1; b >= 0; b--) {
+            const IRBlock *bb = fn->blocks[b];
+            Word *out = row(s->live_out, s, b);
+            const IRInstr *last = bb->count ? &bb->code[bb->count - 1] : NULL;
+            int n = !last ? 0 : last->op == IR_JUMP ? 1 : last->op == IR_BRANCH ? 2 : 0;
+            for (int t = 0; t < n; t++) {
+                const Word *in = row(s->live_in, s, last->target[t]);
+                for (int w = 0; w < s->words; w++)
+                    out[w] |= in[w];
+            }
+
+            memcpy(live, out, (size_t)s->words * sizeof(Word));
+            for (int i = bb->count - 1; i >= 0; i--)
+                step_back(live, &bb->code[i]);
+
+            Word *in = row(s->live_in, s, b);
+            if (memcmp(in, live, (size_t)s->words * sizeof(Word)) != 0) {
+                memcpy(in, live, (size_t)s->words * sizeof(Word));
+                changed = true;
+            }
+        }
+    }
+    free(live);
+}
+
+static void build_interference(Slots *s)
+{
+    const IRFunc *fn = s->fn;
+    Word *live = malloc((size_t)s->words * sizeof(Word));
+    if (!live)
+        error_exit(99, "Out of memory (slot allocation)\n");
+
+    for (int b = 0; b < fn->block_count; b++) {
+        const IRBlock *bb = fn->blocks[b];
+        memcpy(live, row(s->live_out, s, b), (size_t)s->words * sizeof(Word));
+
+        for (int i = bb->count - 1; i >= 0; i--) {
+            const IRInstr *in = &bb->code[i];
+            if (in->dst.kind == IR_OPD_VAR) {
+                int d = in->dst.u.var;
+                int src = in->op == IR_MOVE && in->a.kind == IR_OPD_VAR ? in->a.u.var : -1;
+                for (int v = 0; v < fn->var_count; v++)
+                    if (v != src && test_bit(live, v))
+                        interfere(s, d, v);
+                if (in->op != IR_MOVE) {
+                    if (in->a.kind == IR_OPD_VAR) interfere(s, d, in->a.u.var);
+                    if (in->b.kind == IR_OPD_VAR) interfere(s, d, in->b.u.var);
+                    for (int j = 0; j < in->argc; j++)
+                        if (in->args[j].kind == IR_OPD_VAR)
+                            interfere(s, d, in->args[j].u.var);
+                }
+            }
+            step_back(live, in);
+        }
+    }
+
+    // parameters are all set on entry, together with whatever is live there
+    const Word *entry = row(s->live_in, s, 0);
+    for (int p = 0; p < fn->param_count; p++)
+        for (int v = 0; v < fn->var_count; v++)
+            if (v < fn->param_count || test_bit(entry, v))
+                interfere(s, p, v);
+
+    free(live);
+}
+
+int *ir_assign_slots(const IRFunc *fn, const bool *skip)
+{
+    int n = fn->var_count;
+    int *slot = malloc(((size_t)n + 1) * sizeof(int));
+    if (!slot)
+        error_exit(99, "Out of memory (slot allocation)\n");
+    for (int v = 0; v < n; v++)
+        slot[v] = v;
+    if (n > SLOT_MAX_VARS || fn->block_count == 0)
+        return slot;
+
+    Slots s = { .fn = fn, .words = (n + 63) / 64 };
+    size_t set = (size_t)s.words * sizeof(Word);
+    s.live_in = calloc((size_t)fn->block_count, set);
+    s.live_out = calloc((size_t)fn->block_count, set);
+    s.adj = calloc((size_t)n, set);
+    Word *members = calloc((size_t)n, set);   // per slot, indexed by its first var
+    if (!s.live_in || !s.live_out || !s.adj || !members)
+        error_exit(99, "Out of memory (slot allocation)\n");
+
+    compute_liveness(&s);
+    build_interference(&s);
+
+    // first fit in var order: parameters come first and keep their slot;
+    // a var live on entry that is not a parameter is read before it is
+    // set on some path and keeps a slot of its own
+    const Word *entry = row(s.live_in, &s, 0);
+    for (int v = 0; v < n; v++) {
+        if ((skip && skip[v]) || (v >= fn->param_count && test_bit(entry, v)))
+            continue;
+
+        const Word *adj = row(s.adj, &s, v);
+        for (int r = 0; r < v; r++) {
+            if (slot[r] != r || (skip && skip[r]) ||
+                (r >= fn->param_count && test_bit(entry, r)))
+                continue;
+            Word *m = row(members, &s, r);
+            bool free_slot = true;
+            for (int w = 0; w < s.words && free_slot; w++)
+                free_slot = !(m[w] & adj[w]);
+            if (free_slot) {
+                slot[v] = r;
+                break;
+            }
+        }
+        set_bit(row(members, &s, slot[v]), v);
+    }
+
+    free(members);
+    free(s.adj);
+    free(s.live_out);
+    free(s.live_in);
+    return slot;
+}
@@ -0,0 +1,74 @@
+// ir_tailcall.c
+
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Self tail calls
+   `return f(args)` inside f itself is turned into assigning
+   the arguments to the parameters and jumping back to the
+   entry block, so deep recursion runs in a single frame.
+   --------------------------------------------------------- */
+
+static bool is_self_call(const IRFunc *fn, const IRInstr *in)
+{
+    return in->op == IR_CALL && in->argc == fn->param_count &&
+           (in->func == fn->name || strcmp(in->func, fn->name) == 0);
+}
+
+// bb ends in `t = call <fn>(..); return t`
+static bool tail_call_at(const IRFunc *fn, const IRBlock *bb)
+{
+    if (bb->count < 2)
+        return false;
+
+    const IRInstr *call = &bb->code[bb->count - 2];
+    const IRInstr *ret = &bb->code[bb->count - 1];
+
+    return is_self_call(fn, call) && ret->op == IR_RETURN &&
+           call->dst.kind == IR_OPD_VAR && ret->a.kind == IR_OPD_VAR &&
+           call->dst.u.var == ret->a.u.var;
+}
+
+static void rewrite_tail_call(IRFunc *fn, IRBlock *bb)
+{
+    IRInstr call = bb->code[bb->count - 2];
+    bb->count -= 2;
+
+    // parameters are assigned in order; an argument that reads another
+    // parameter is saved first, it could already be overwritten
+    for (int i = 0; i < call.argc; i++) {
+        IROperand arg = call.args[i];
+        if (arg.kind == IR_OPD_VAR && fn->vars[arg.u.var].kind == IR_VAR_PARAM &&
+            arg.u.var != i) {
+            IRInstr *save = ir_append(bb, IR_MOVE);
+            save->dst = ir_var(ir_new_var(fn, IR_VAR_TEMP, NULL, fn->vars[arg.u.var].type_mask));
+            save->a = arg;
+            call.args[i] = save->dst;
+        }
+    }
+
+    for (int i = 0; i < call.argc; i++) {
+        IROperand arg = call.args[i];
+        if (arg.kind == IR_OPD_VAR && arg.u.var == i)
+            continue;
+        IRInstr *move = ir_append(bb, IR_MOVE);
+        move->dst = ir_var(i);          // parameters are vars 0 .. param_count-1
+        move->a = arg;
+    }
+
+    ir_append(bb, IR_JUMP)->target[0] = 0;
+    free(call.args);
+}
+
+void ir_tail_calls(IRProgram *prog)
+{
+    for (int f = 0; f < prog->func_count; f++) {
+        IRFunc *fn = prog->funcs[f];
+        for (int b = 0; b < fn->block_count; b++)
+            if (tail_call_at(fn, fn->blocks[b]))
+                rewrite_tail_call(fn, fn->blocks[b]);
+    }
+}
@@ -4,6 +4,7 @@
 #include "scanner.h"
 #include "err.h"
 #include "ast.h"
+#include "psa.h"
 #include <string.h>
 
 // Added for semantik analysis and symbol table
@@ -53,30 +54,22 @@ ASTNode *return_tail();
 void arg_list(ASTNode *call);
 void arg_more(ASTNode *alist);
 
-ASTNode *parse_expr();   // placeholder
+ASTNode *parse_expr();
 
 // helpers
 static void next_token();
 static void eat_eol_o();
 static void eat_eol_m();
-static int is_keyword(const char *kw);
+static int is_keyword(KeywordKind kw);
 static const char *tok2symbol(TokenType t);
 
-Token *copy_token(const Token *src);
-
-
-static void free_token_contents(Token *t)
-{
-    if (t->lexeme) {
-        free(t->lexeme);
-        t->lexeme = NULL;
-    }
-}
 
 static void next_token()
 {
-    free_token_contents(&current_token);
     current_token = scanner_next();
+    if (current_token.type == TOK_ERROR)
+        error_exit(1, "Lexical error: %s\n",
+                   current_token.lexeme ? current_token.lexeme : "");
 }
 
 
@@ -136,33 +129,8 @@ static void expect(TokenType type) {
     next_token();
 }
 
-static int is_keyword(const char *kw) {
-    if (current_token.type != TOK_KEYWORD) return 0;
-    if (!current_token.lexeme) return 0;
-    return strcmp(current_token.lexeme, kw) == 0;
-}
-
-Token *copy_token(const Token *src)
-{
-    if (!src) return NULL;
-
-    Token *t = malloc(sizeof(Token));
-    if (!t)
-        error_exit(99, "AST: malloc failed in copy_token()\n");
-
-    t->type = src->type;
-
-    if (src->lexeme) {
-        size_t len = strlen(src->lexeme);
-        t->lexeme = malloc(len + 1);
-        if (!t->lexeme)
-            error_exit(99, "AST: malloc failed for token lexeme\n");
-        memcpy(t->lexeme, src->lexeme, len + 1);
-    } else {
-        t->lexeme = NULL;
-    }
-
-    return t;
+static int is_keyword(KeywordKind kw) {
+    return current_token.type == TOK_KEYWORD && current_token.keyword == kw;
 }
 
 static void eat_eol_o(){
@@ -183,6 +151,9 @@ static void eat_eol_m(void) {
 
 ASTNode *parser_prog(){
 
+    // the tree lives until the caller's ast_arena_release()
+    ast_arena_begin();
+
     next_token();
 
     ASTNode *root = ast_new(AST_PROGRAM,NULL);
@@ -202,7 +173,8 @@ ASTNode *parser_prog(){
 ASTNode *parser_prolog(){
 
     ASTNode *prolog = ast_new(AST_PROLOG,NULL);
-    if (!is_keyword("import")){
+    eat_eol_o();
+    if (!is_keyword(KW_IMPORT)){
         error_exit(2,"expected 'import' at the start of program \n");
     }
     next_token();
@@ -213,19 +185,19 @@ ASTNode *parser_prolog(){
         || strcmp(current_token.lexeme, "ifj25") != 0){
             error_exit(2 ,"expected 'ifj25' at the start of program \n");
         }
-    ast_add_child(prolog,ast_new(AST_LITERAL,copy_token(&current_token)));
+    ast_add_child(prolog,ast_new(AST_LITERAL,&current_token));
     next_token();
 
-    if (!is_keyword("for")){
+    if (!is_keyword(KW_FOR)){
         error_exit(2,"expected 'for' after import \n");
     }
     next_token();
     eat_eol_o();
 
-    if (!is_keyword("Ifj")){
+    if (!is_keyword(KW_Ifj)){
         error_exit(2,"expected 'Ifj' after for \n");
     }
-    ast_add_child(prolog,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(prolog,ast_new(AST_IDENTIFIER,&current_token));
     next_token();
     eat_eol_m();
     return prolog;
@@ -235,7 +207,7 @@ ASTNode *parser_class_def(){
     ASTNode *class_def = ast_new(AST_CLASS,NULL);
     ASTNode *fs = ast_new(AST_FUNCTION_S,NULL);
 
-    if (!is_keyword("class")){
+    if (!is_keyword(KW_CLASS)){
         error_exit(2 ,"expected 'class' at the start of class %s \n",tok2symbol(current_token.type));
         printf("%d",current_token.type);
     }
@@ -247,7 +219,7 @@ ASTNode *parser_class_def(){
         error_exit(2,"expected class name 'Program' after class\n");
     }
 
-    ast_add_child(class_def,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(class_def,ast_new(AST_IDENTIFIER,&current_token));
 
     next_token();
     expect(TOK_LBRACE);
@@ -265,7 +237,7 @@ ASTNode *parser_class_def(){
 
 ASTNode *parser_function_defs(){
     ASTNode *functions = ast_new(AST_FUNCTION_S,NULL);
-    while(is_keyword("static")){
+    while(is_keyword(KW_STATIC)){
         ASTNode *f = parser_function_def();
         ast_add_child(functions,f);
     }
@@ -275,14 +247,14 @@ ASTNode *parser_function_defs(){
 ASTNode *parser_function_def(){
     ASTNode *f = ast_new(AST_FUNCTION_DEF,NULL);
 
-    if (!is_keyword("static")){
+    if (!is_keyword(KW_STATIC)){
         error_exit(2,"expected 'static' at the start of function\n");
     }
     next_token();
     if (current_token.type != TOK_IDENTIFIER) {
         error_exit(2,"expected function name after 'static'\n");
     }
-    ast_add_child(f,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(f,ast_new(AST_IDENTIFIER,&current_token));
     const char *fname = current_token.lexeme;
     next_token();
 
@@ -322,7 +294,7 @@ ASTNode *parser_function_pick(const char *fname){
 
     int arity = plist->child_count;
 
-    char *key = make_func_key(fname, arity);
+    const char *key = make_func_key(fname, arity);
 
     SymInfo *sym = calloc(1, sizeof(SymInfo));
     sym->kind = SYM_FUNC;
@@ -338,7 +310,6 @@ ASTNode *parser_function_pick(const char *fname){
                 fname, arity);
     }
 
-    free(key);
 
     ASTNode *blok = block();
     ast_add_child(f_pick,blok);
@@ -351,7 +322,7 @@ ASTNode *parser_function_pick(const char *fname){
 ASTNode *parser_getter_pick(const char *fname){
     ASTNode *f_get = ast_new(AST_GETTER,NULL);
 
-    char *key = make_getter_key(fname);
+    const char *key = make_getter_key(fname);
 
     SymInfo *sym = calloc(1, sizeof(SymInfo));
     sym->kind = SYM_FUNC;
@@ -365,7 +336,6 @@ ASTNode *parser_getter_pick(const char *fname){
         error_exit(4, "redefinition of getter '%s'\n", fname);
     }
 
-    free(key);
 
     ASTNode *blok = block();
     ast_add_child(f_get,blok);
@@ -379,7 +349,7 @@ ASTNode *parser_setter_pick(const char *fname){
     ASTNode *f_set = ast_new(AST_SETTER,NULL);
 
     // Insert symbol FIRST
-    char *key = make_setter_key(fname);
+    const char *key = make_setter_key(fname);
 
     SymInfo *sym = calloc(1, sizeof(SymInfo));
     sym->kind = SYM_FUNC;
@@ -392,7 +362,6 @@ ASTNode *parser_setter_pick(const char *fname){
     if (!symtable_insert(g_global_symtable, key, sym)) {
         error_exit(4, "redefinition of setter '%s'\n", fname);
     }
-    free(key);
 
     // Now parse syntax
     expect(TOK_ASSIGN);
@@ -401,7 +370,7 @@ ASTNode *parser_setter_pick(const char *fname){
     if (current_token.type != TOK_IDENTIFIER) {
         error_exit(2,"expected setter parameter identifier\n");
     }
-    ast_add_child(f_set,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(f_set,ast_new(AST_IDENTIFIER,&current_token));
     next_token();
 
     expect(TOK_RPAREN);
@@ -422,7 +391,7 @@ ASTNode *param_list(){
     if (current_token.type != TOK_IDENTIFIER) {
         error_exit(2,"expected setter id after 'static'\n");
     }
-    ast_add_child(param_list,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(param_list,ast_new(AST_IDENTIFIER,&current_token));
 
     next_token();
 
@@ -446,7 +415,7 @@ void param_more(ASTNode *list){
     if (current_token.type != TOK_IDENTIFIER) {
         error_exit(2,"expected setter id after 'static'\n");
     }
-    ast_add_child(list,ast_new(AST_IDENTIFIER,copy_token(&current_token)));
+    ast_add_child(list,ast_new(AST_IDENTIFIER,&current_token));
 
     next_token();
 
@@ -462,6 +431,7 @@ ASTNode *block(){
     eat_eol_m();
     
     parser_statements(blok);
+    ast_shrink_to_fit(blok);
     
     expect(TOK_RBRACE);
     
@@ -471,42 +441,24 @@ ASTNode *block(){
 void parser_statements(ASTNode *blok) {
     
     while (
-        is_keyword("var") ||
-        is_keyword("return") ||
-        is_keyword("if") ||
-        is_keyword("while") || current_token.type == TOK_IDENTIFIER ||
+        is_keyword(KW_VAR) ||
+        is_keyword(KW_RETURN) ||
+        is_keyword(KW_IF) ||
+        is_keyword(KW_WHILE) || current_token.type == TOK_IDENTIFIER ||
         current_token.type == TOK_GID ||
-        is_keyword("Ifj")) {
+        current_token.type == TOK_LBRACE ||
+        is_keyword(KW_Ifj)) {
             parser_statement(blok);
 
         }
 
 }
     
-    typedef enum {
-        KW_NONE = 0,
-        KW_VAR,
-        KW_RETURN,
-        KW_IF,
-        KW_WHILE,
-        KW_ELSE,
-        KW_Ifj     
-    } KeywordKind;
-    
-    
-    static KeywordKind get_keyword(void) {
-        if (current_token.type != TOK_KEYWORD)
-        return KW_NONE;
-        
-        if (strcmp(current_token.lexeme, "var") == 0) return KW_VAR;
-        if (strcmp(current_token.lexeme, "return") == 0) return KW_RETURN;
-        if (strcmp(current_token.lexeme, "if") == 0) return KW_IF;
-        if (strcmp(current_token.lexeme, "while") == 0) return KW_WHILE;
-        if (strcmp(current_token.lexeme, "else") == 0) return KW_ELSE; 
-        if (strcmp(current_token.lexeme, "Ifj") == 0) return KW_Ifj;  // ← DOPLNIŤ
-        
+static KeywordKind get_keyword(void) {
+    if (current_token.type != TOK_KEYWORD)
         return KW_NONE;
-    }
+    return current_token.keyword;
+}
 
 //-------------------------------------
 //   ABSTRACT STATEMENT DISPATCHER
@@ -521,6 +473,13 @@ void parser_statement(ASTNode *blok)
         return;
     }
 
+    // nested block, opens its own scope
+    if (current_token.type == TOK_LBRACE) {
+        ast_add_child(blok, block());
+        eat_eol_m();
+        return;
+    }
+
     switch (get_keyword()) {
         case KW_VAR: {
             ASTNode *v = statement_var();
@@ -580,7 +539,7 @@ ASTNode *statement_var(void)
     if (current_token.type != TOK_IDENTIFIER)
         error_exit(2, "expected identifier after 'var'\n");
 
-    ASTNode *var = ast_new(AST_VAR_DECL, copy_token(&current_token));
+    ASTNode *var = ast_new(AST_VAR_DECL, &current_token);
     next_token();
 
     ASTNode *tail = var_tail();
@@ -630,7 +589,7 @@ ASTNode *statement_if()
     ASTNode *then_blk = block();
     ast_add_child(ifnode, then_blk);
 
-    if (!is_keyword("else"))
+    if (!is_keyword(KW_ELSE))
         error_exit(2, "expected 'else' after if-block\n");
 
     next_token();
@@ -677,14 +636,14 @@ ASTNode *statement_while()
 ASTNode *parser_func_name()
 {
     // Očakávame Ifj
-    if (!is_keyword("Ifj"))
+    if (!is_keyword(KW_Ifj))
         error_exit(2, "expected 'Ifj' for builtin function");
 
     // Uzel pre názov funkcie (Ifj.name)
     ASTNode *fname = ast_new(AST_FUNC_NAME, NULL);
 
     // Pridáme prvý identifikátor: Ifj
-    ast_add_child(fname, ast_new(AST_IDENTIFIER, copy_token(&current_token)));
+    ast_add_child(fname, ast_new(AST_IDENTIFIER, &current_token));
     next_token();
 
     // Musí byť bodka
@@ -696,7 +655,7 @@ ASTNode *parser_func_name()
     if (current_token.type != TOK_IDENTIFIER)
         error_exit(2, "expected identifier after 'Ifj.'");
 
-    ast_add_child(fname, ast_new(AST_IDENTIFIER, copy_token(&current_token)));
+    ast_add_child(fname, ast_new(AST_IDENTIFIER, &current_token));
     next_token();
 
     
@@ -729,10 +688,10 @@ ASTNode *statement_sid()
     ASTNode *idnode;
 
     if (current_token.type == TOK_IDENTIFIER) {
-        idnode = ast_new(AST_IDENTIFIER, copy_token(&current_token));
+        idnode = ast_new(AST_IDENTIFIER, &current_token);
     }
     else if (current_token.type == TOK_GID) {
-        idnode = ast_new(AST_GID, copy_token(&current_token));
+        idnode = ast_new(AST_GID, &current_token);
     }
     
     else {
@@ -785,7 +744,7 @@ ASTNode *id_tail(Token *id)
         ASTNode *expr = parse_expr();
         eat_eol_m();
 
-        ASTNode *assign = ast_new(AST_ASSIGN, copy_token(id));
+        ASTNode *assign = ast_new(AST_ASSIGN, id);
         ast_add_child(assign, expr);
         return assign;
     }
@@ -793,7 +752,7 @@ ASTNode *id_tail(Token *id)
     if (current_token.type == TOK_LPAREN) {
         next_token();
 
-        ASTNode *call = ast_new(AST_CALL, copy_token(id));
+        ASTNode *call = ast_new(AST_CALL, id);
         arg_list(call);
 
         expect(TOK_RPAREN);
@@ -857,23 +816,21 @@ void arg_more(ASTNode *call)
 
 
 //-------------------------------------
-//   FAKE EXPR  (placeholder until precedence parser)
+//   EXPRESSION (precedence parser)
 //-------------------------------------
 ASTNode *parse_expr()
 {
-    // BUILT-IN Ifj.xxx alebo Ifj.xxx(...)
-    if (is_keyword("Ifj")) {
-        return parser_func_name();   // vracia GETTER alebo CALL
-    }
-
-    // ----- pôvodná fake implementácia -----
-
     if (!starts_expr(current_token))
         error_exit(2, "expected expression\n");
 
-    ASTNode *expr = ast_new(AST_EXPR, copy_token(&current_token));
-    next_token();
+    Token end;
+    ASTNode *expr = NULL;
 
+    if (psa_parse_expression(current_token, &end, &expr) != PSA_OK || !expr)
+        error_exit(2, "Syntax error: invalid expression\n");
+
+    // the PSA stops at the first token that is not part of the expression
+    current_token = end;
     return expr;
 }
 
@@ -891,6 +848,9 @@ static int starts_expr(Token t)
         case TOK_LPAREN:
             return 1;
 
+        case TOK_KEYWORD:
+            return t.keyword == KW_Ifj || t.keyword == KW_NULL;
+
         default:
             return 0;
     }
@@ -0,0 +1,310 @@
+// peephole.c
+
+#include "peephole.h"
+#include "err.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------
+   Instruction lines
+   --------------------------------------------------------- */
+
+#define PEEP_MAX_ARGS   3
+#define PEEP_WINDOW     4
+
+typedef struct {
+    const char *s;
+    int len;
+} Slice;
+
+typedef struct {
+    const char *text;       // points into the input or into `owned`
+    int   len;              // 0 for blank lines
+    Slice op;
+    Slice arg[PEEP_MAX_ARGS];
+    int   argc;
+    bool  dead;
+    char *owned;            // text of a rewritten line
+} PLine;
+
+static void parse_line(PLine *l)
+{
+    const char *p = l->text, *end = l->text + l->len;
+    Slice *parts[1 + PEEP_MAX_ARGS] = { &l->op, &l->arg[0], &l->arg[1], &l->arg[2] };
+    int n = 0;
+
+    memset(l->arg, 0, sizeof(l->arg));
+    l->op = (Slice){ p, 0 };
+
+    // operands never contain spaces, string@ escapes them
+    while (p < end && n < 1 + PEEP_MAX_ARGS) {
+        const char *start = p;
+        while (p < end && *p != ' ')
+            p++;
+        *parts[n++] = (Slice){ start, (int)(p - start) };
+        while (p < end && *p == ' ')
+            p++;
+    }
+    l->argc = n > 0 ? n - 1 : 0;
+}
+
+static bool is_op(const PLine *l, const char *op)
+{
+    return l->op.len == (int)strlen(op) && memcmp(l->op.s, op, (size_t)l->op.len) == 0;
+}
+
+static bool same(Slice a, Slice b)
+{
+    return a.len == b.len && memcmp(a.s, b.s, (size_t)a.len) == 0;
+}
+
+static bool slice_is(Slice a, const char *s)
+{
+    return a.len == (int)strlen(s) && memcmp(a.s, s, (size_t)a.len) == 0;
+}
+
+// replaces the text of `l`, format arguments may point into `l` itself
+static void rewrite(PLine *l, const char *fmt, ...)
+{
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    char *text = malloc((size_t)n + 1);
+    if (!text)
+        error_exit(99, "Out of memory (peephole)\n");
+    vsnprintf(text, (size_t)n + 1, fmt, ap2);
+    va_end(ap2);
+
+    free(l->owned);
+    l->owned = text;
+    l->text = text;
+    l->len = n;
+    parse_line(l);
+}
+
+/* ---------------------------------------------------------
+   Rules
+   Each rule looks at a window of consecutive live
+   instructions (blank lines skipped) and returns how many
+   instructions it removed, 0 when it does not match.
+   --------------------------------------------------------- */
+
+typedef int (*PeepFn)(PLine **w, int n);
+
+// MOVE X X
+static int rule_move_self(PLine **w, int n)
+{
+    (void)n;
+    if (!is_op(w[0], "MOVE") || !same(w[0]->arg[0], w[0]->arg[1]))
+        return 0;
+    w[0]->dead = true;
+    return 1;
+}
+
+// MOVE X Y; MOVE Y X → MOVE X Y
+static int rule_move_back(PLine **w, int n)
+{
+    if (n < 2 || !is_op(w[0], "MOVE") || !is_op(w[1], "MOVE"))
+        return 0;
+    if (!same(w[0]->arg[0], w[1]->arg[1]) || !same(w[0]->arg[1], w[1]->arg[0]))
+        return 0;
+    w[1]->dead = true;
+    return 1;
+}
+
+// PUSHS a; POPS b → MOVE b a
+static int rule_push_pop(PLine **w, int n)
+{
+    if (n < 2 || !is_op(w[0], "PUSHS") || !is_op(w[1], "POPS"))
+        return 0;
+
+    w[1]->dead = true;
+    if (same(w[0]->arg[0], w[1]->arg[0])) {
+        w[0]->dead = true;
+        return 2;
+    }
+    rewrite(w[0], "MOVE %.*s %.*s", w[1]->arg[0].len, w[1]->arg[0].s,
+            w[0]->arg[0].len, w[0]->arg[0].s);
+    return 1;
+}
+
+// NOT x x; NOT x x  /  NOTS; NOTS
+static int rule_double_not(PLine **w, int n)
+{
+    if (n < 2)
+        return 0;
+    bool stack = is_op(w[0], "NOTS") && is_op(w[1], "NOTS");
+    bool regs = is_op(w[0], "NOT") && is_op(w[1], "NOT") &&
+                same(w[0]->arg[0], w[0]->arg[1]) &&
+                same(w[1]->arg[0], w[1]->arg[1]) &&
+                same(w[0]->arg[0], w[1]->arg[0]);
+    if (!stack && !regs)
+        return 0;
+    w[0]->dead = w[1]->dead = true;
+    return 2;
+}
+
+// EQS|LTS|GTS; NOTS; PUSHS bool@b; JUMPIF(N)EQS L → EQS|LTS|GTS; PUSHS bool@!b; JUMPIF(N)EQS L
+// NOTS fails on a non-bool while JUMPIFEQS accepts nil, so the value
+// must come from a comparison
+static int rule_not_branch(PLine **w, int n)
+{
+    if (n < 4 || !(is_op(w[0], "EQS") || is_op(w[0], "LTS") || is_op(w[0], "GTS")) ||
+        !is_op(w[1], "NOTS") || !is_op(w[2], "PUSHS") ||
+        !(is_op(w[3], "JUMPIFEQS") || is_op(w[3], "JUMPIFNEQS")))
+        return 0;
+
+    if (slice_is(w[2]->arg[0], "bool@false"))
+        rewrite(w[2], "PUSHS bool@true");
+    else if (slice_is(w[2]->arg[0], "bool@true"))
+        rewrite(w[2], "PUSHS bool@false");
+    else
+        return 0;
+    w[1]->dead = true;
+    return 1;
+}
+
+// JUMP L; LABEL ..; LABEL L
+static int rule_jump_next(PLine **w, int n)
+{
+    if (!is_op(w[0], "JUMP"))
+        return 0;
+    for (int i = 1; i < n && is_op(w[i], "LABEL"); i++) {
+        if (same(w[i]->arg[0], w[0]->arg[0])) {
+            w[0]->dead = true;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// nothing after JUMP / RETURN / EXIT runs until the next LABEL
+static int rule_dead_code(PLine **w, int n)
+{
+    if (n < 2 || !(is_op(w[0], "JUMP") || is_op(w[0], "RETURN") || is_op(w[0], "EXIT")))
+        return 0;
+    if (is_op(w[1], "LABEL"))
+        return 0;
+    w[1]->dead = true;
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    PeepFn      apply;
+    int         removed;
+} PeepRule;
+
+static PeepRule rules[] = {
+    { "move-self",  rule_move_self,  0 },
+    { "move-back",  rule_move_back,  0 },
+    { "push-pop",   rule_push_pop,   0 },
+    { "double-not", rule_double_not, 0 },
+    { "not-branch", rule_not_branch, 0 },
+    { "jump-next",  rule_jump_next,  0 },
+    { "dead-code",  rule_dead_code,  0 },
+};
+
+#define RULE_COUNT ((int)(sizeof(rules) / sizeof(rules[0])))
+
+/* ---------------------------------------------------------
+   Driver
+   --------------------------------------------------------- */
+
+// the next `max` live instructions from `i` on
+static int window(PLine *lines, int count, int i, PLine **w, int max)
+{
+    int n = 0;
+    for (; i < count && n < max; i++)
+        if (!lines[i].dead && lines[i].len > 0)
+            w[n++] = &lines[i];
+    return n;
+}
+
+char *peephole_optimize(const char *code, size_t len, size_t *out_len, FILE *stats)
+{
+    int count = 0;
+    for (size_t i = 0; i < len; i++)
+        if (code[i] == '\n')
+            count++;
+    if (len > 0 && code[len - 1] != '\n')
+        count++;
+
+    PLine *lines = calloc((size_t)count + 1, sizeof(PLine));
+    if (!lines)
+        error_exit(99, "Out of memory (peephole)\n");
+
+    const char *p = code, *end = code + len;
+    for (int i = 0; i < count; i++) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl)
+            nl = end;
+        lines[i].text = p;
+        lines[i].len = (int)(nl - p);
+        parse_line(&lines[i]);
+        p = nl + 1;
+    }
+
+    for (int r = 0; r < RULE_COUNT; r++)
+        rules[r].removed = 0;
+
+    // one rewrite can expose another, repeat until nothing matches
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < count; i++) {
+            if (lines[i].dead || lines[i].len == 0)
+                continue;
+
+            PLine *w[PEEP_WINDOW];
+            int n = window(lines, count, i, w, PEEP_WINDOW);
+            for (int r = 0; r < RULE_COUNT; r++) {
+                int removed = rules[r].apply(w, n);
+                if (removed) {
+                    rules[r].removed += removed;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    size_t size = 1;
+    for (int i = 0; i < count; i++)
+        if (!lines[i].dead)
+            size += (size_t)lines[i].len + 1;
+
+    char *out = malloc(size);
+    if (!out)
+        error_exit(99, "Out of memory (peephole)\n");
+    char *o = out;
+    for (int i = 0; i < count; i++) {
+        if (lines[i].dead)
+            continue;
+        memcpy(o, lines[i].text, (size_t)lines[i].len);
+        o += lines[i].len;
+        *o++ = '\n';
+    }
+    *o = '\0';
+    *out_len = (size_t)(o - out);
+
+    if (stats) {
+        int total = 0;
+        for (int r = 0; r < RULE_COUNT; r++) {
+            fprintf(stats, "peephole: %-12s %d\n", rules[r].name, rules[r].removed);
+            total += rules[r].removed;
+        }
+        fprintf(stats, "peephole: %-12s %d of %d\n", "total", total, count);
+    }
+
+    for (int i = 0; i < count; i++)
+        free(lines[i].owned);
+    free(lines);
+    return out;
+}
@@ -0,0 +1,20 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* ---------------------------------------------------------
+   Peephole optimizer
+   Works on finished IFJcode25 text, one instruction per line,
+   with a table of small patterns that are rewritten until
+   none of them matches any more.
+   --------------------------------------------------------- */
+
+/// Rewrite `len` bytes of IFJcode25 in `code`.
+/// Returns the new program (malloc'd, NUL-terminated) and its length in
+/// *out_len. When `stats` is not NULL, the number of instructions each
+/// rule removed is printed there.
+char *peephole_optimize(const char *code, size_t len, size_t *out_len, FILE *stats);
+
+#endif
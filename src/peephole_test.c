@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "peephole.h"
+#include "symtable.h"
+
+// `make unit-test` links every compiler source, which expects main.c's table
+SymTable *g_global_symtable = NULL;
+
+// ------------------------------------------------------------
+// Test infrastructure
+// ------------------------------------------------------------
+
+static const char *rule_names[] = {
+    "move-self", "move-back", "push-pop", "double-not",
+    "not-branch", "jump-next", "dead-code",
+};
+
+#define RULE_NAMES ((int)(sizeof(rule_names) / sizeof(rule_names[0])))
+
+typedef struct {
+    const char *name;
+    const char *before;
+    const char *after;
+    const char *removed;    // "rule=n ...", rules not listed removed nothing
+} PeepTest;
+
+// instructions `rule` is expected to remove according to `spec`
+static int expected_removed(const char *spec, const char *rule)
+{
+    size_t len = strlen(rule);
+    for (const char *p = spec; (p = strstr(p, rule)) != NULL; p += len)
+        if ((p == spec || p[-1] == ' ') && p[len] == '=')
+            return atoi(p + len + 1);
+    return 0;
+}
+
+// count printed for `rule` in the --peephole-stats text, -1 if missing
+static int stats_removed(const char *stats, const char *rule)
+{
+    char key[32];
+    snprintf(key, sizeof key, "peephole: %-12s ", rule);
+    const char *p = strstr(stats, key);
+    return p ? atoi(p + strlen(key)) : -1;
+}
+
+static int run_one_peep_test(const PeepTest *tc)
+{
+    FILE *f = tmpfile();
+    if (!f) {
+        printf("tmpfile() failed\n");
+        return 0;
+    }
+
+    size_t len;
+    char *out = peephole_optimize(tc->before, strlen(tc->before), &len, f);
+
+    char stats[1024];
+    rewind(f);
+    size_t n = fread(stats, 1, sizeof stats - 1, f);
+    stats[n] = '\0';
+    fclose(f);
+
+    int pass = strcmp(out, tc->after) == 0 && len == strlen(tc->after);
+    int total = 0;
+    for (int r = 0; r < RULE_NAMES; r++) {
+        int want = expected_removed(tc->removed, rule_names[r]);
+        int got = stats_removed(stats, rule_names[r]);
+        if (got != want) {
+            printf("    %s removed %d, expected %d\n", rule_names[r], got, want);
+            pass = 0;
+        }
+        total += want;
+    }
+    if (stats_removed(stats, "total") != total)
+        pass = 0;
+
+    printf("[%-24s] %s\n", tc->name, pass ? "PASS" : "FAIL");
+    if (!pass) {
+        printf("    input:\n%s", tc->before);
+        printf("    expected:\n%s", tc->after);
+        printf("    got:\n%s", out);
+        printf("    stats:\n%s", stats);
+    }
+
+    free(out);
+    return pass;
+}
+
+int main(void)
+{
+    const PeepTest tests[] = {
+        // move-self
+        { "move_self",
+          "MOVE LF@x LF@x\nWRITE LF@x\n",
+          "WRITE LF@x\n", "move-self=1" },
+        { "move_other",
+          "MOVE LF@x LF@y\n",
+          "MOVE LF@x LF@y\n", "" },
+
+        // move-back
+        { "move_back",
+          "MOVE LF@x LF@y\nMOVE LF@y LF@x\n",
+          "MOVE LF@x LF@y\n", "move-back=1" },
+        { "move_back_across_label",
+          "MOVE LF@x LF@y\nLABEL l\nMOVE LF@y LF@x\n",
+          "MOVE LF@x LF@y\nLABEL l\nMOVE LF@y LF@x\n", "" },
+        { "move_back_other_var",
+          "MOVE LF@x LF@y\nMOVE LF@y LF@z\n",
+          "MOVE LF@x LF@y\nMOVE LF@y LF@z\n", "" },
+
+        // push-pop
+        { "push_pop",
+          "PUSHS LF@a\nPOPS LF@b\n",
+          "MOVE LF@b LF@a\n", "push-pop=1" },
+        { "push_pop_same",
+          "PUSHS LF@a\nPOPS LF@a\n",
+          "", "push-pop=2" },
+        { "push_pop_constant",
+          "PUSHS int@5\n\nPOPS GF@g\n",
+          "MOVE GF@g int@5\n\n", "push-pop=1" },
+        { "push_op_pop",
+          "PUSHS LF@a\nADDS\nPOPS LF@b\n",
+          "PUSHS LF@a\nADDS\nPOPS LF@b\n", "" },
+        { "push_pop_across_label",
+          "PUSHS LF@a\nLABEL l\nPOPS LF@b\n",
+          "PUSHS LF@a\nLABEL l\nPOPS LF@b\n", "" },
+
+        // double-not
+        { "double_nots",
+          "LTS\nNOTS\nNOTS\nPOPS LF@c\n",
+          "LTS\nPOPS LF@c\n", "double-not=2" },
+        { "double_not",
+          "NOT LF@c LF@c\nNOT LF@c LF@c\n",
+          "", "double-not=2" },
+        { "double_not_other_var",
+          "NOT LF@c LF@c\nNOT LF@d LF@d\n",
+          "NOT LF@c LF@c\nNOT LF@d LF@d\n", "" },
+        { "double_not_copy",
+          "NOT LF@c LF@d\nNOT LF@c LF@d\n",
+          "NOT LF@c LF@d\nNOT LF@c LF@d\n", "" },
+
+        // not-branch
+        { "not_branch",
+          "EQS\nNOTS\nPUSHS bool@false\nJUMPIFEQS else\n",
+          "EQS\nPUSHS bool@true\nJUMPIFEQS else\n", "not-branch=1" },
+        { "not_branch_neq",
+          "GTS\nNOTS\nPUSHS bool@true\nJUMPIFNEQS l\n",
+          "GTS\nPUSHS bool@false\nJUMPIFNEQS l\n", "not-branch=1" },
+        { "not_branch_unknown_value",       // NOTS must still fail on nil
+          "PUSHS LF@v\nNOTS\nPUSHS bool@false\nJUMPIFEQS else\n",
+          "PUSHS LF@v\nNOTS\nPUSHS bool@false\nJUMPIFEQS else\n", "" },
+        { "not_branch_var_operand",
+          "EQS\nNOTS\nPUSHS LF@b\nJUMPIFEQS else\n",
+          "EQS\nNOTS\nPUSHS LF@b\nJUMPIFEQS else\n", "" },
+
+        // jump-next
+        { "jump_next",
+          "JUMP l\nLABEL k\nLABEL l\n",
+          "LABEL k\nLABEL l\n", "jump-next=1" },
+        { "jump_elsewhere",
+          "JUMP m\nLABEL l\nWRITE int@1\nLABEL m\n",
+          "JUMP m\nLABEL l\nWRITE int@1\nLABEL m\n", "" },
+
+        // dead-code
+        { "dead_after_return",
+          "RETURN\nWRITE int@1\nPOPFRAME\nLABEL f\nWRITE int@2\n",
+          "RETURN\nLABEL f\nWRITE int@2\n", "dead-code=2" },
+        { "dead_after_exit",
+          "EXIT int@0\nWRITE int@1\n",
+          "EXIT int@0\n", "dead-code=1" },
+        { "dead_then_jump_next",
+          "JUMP l\nWRITE int@1\nLABEL l\n",
+          "LABEL l\n", "dead-code=1 jump-next=1" },
+        { "live_after_label",
+          "RETURN\nLABEL f\nWRITE int@1\n",
+          "RETURN\nLABEL f\nWRITE int@1\n", "" },
+        { "live_after_cond_jump",
+          "JUMPIFEQ l LF@a LF@b\nWRITE int@1\nLABEL l\n",
+          "JUMPIFEQ l LF@a LF@b\nWRITE int@1\nLABEL l\n", "" },
+    };
+
+    int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int passed = 0;
+
+    for (int i = 0; i < count; ++i)
+        passed += run_one_peep_test(&tests[i]);
+
+    printf("peephole test summary: %d / %d passed\n", passed, count);
+    return passed == count ? 0 : 1;
+}
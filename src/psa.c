@@ -1,8 +1,13 @@
 #include "psa.h"
 #include "psa_stack.h"
 #include "scanner.h"
+#include "err.h"
+#include "intern.h"
+#include "symtable.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <stdlib.h>   // NEW: free()
+#include <stdbool.h>
 
 // -------------------- Operator Precedence Table --------------------
 PrecedenceRelation prec_table[9][9] = {
@@ -57,7 +62,7 @@ PrecedenceGroup token_to_group(const Token *tok)
         return GRP_ID;
 
     case TOK_KEYWORD:
-        if (tok->lexeme && strcmp(tok->lexeme, "is") == 0)
+        if (tok->keyword == KW_IS)
             return GRP_IS;
         return GRP_ID;
 
@@ -66,10 +71,14 @@ PrecedenceGroup token_to_group(const Token *tok)
     }
 }
 
-// -------------------- End-of-expression tokens (iba EOF) --------------------
-static int is_expr_end_token(TokenType t)
+// -------------------- End-of-expression tokens --------------------
+// Anything outside the expression grammar ends it (`,`, `{`, `}`, EOF...);
+// `)` does only when it has no matching `(` inside the expression.
+static int is_expr_end_token(const Token *t, int depth)
 {
-    return (t == TOK_EOF);
+    if (t->type == TOK_RPAREN)
+        return depth == 0;
+    return token_to_group(t) == GRP_EOF;
 }
 
 static int is_op_or_lparen(TokenType last_type, int last_is_is_op)
@@ -95,13 +104,20 @@ static int is_op_or_lparen(TokenType last_type, int last_is_is_op)
     }
 }
 
+// a line starting with a binary operator continues the previous one
+static int is_binary_op_token(const Token *t)
+{
+    PrecedenceGroup g = token_to_group(t);
+    return g == GRP_MUL_DIV || g == GRP_ADD_SUB || g == GRP_REL ||
+           g == GRP_IS || g == GRP_EQ;
+}
 
-static inline void free_token_lexeme(Token *tok)
+static Token psa_next(void)
 {
-    if (tok && tok->lexeme) {
-        free(tok->lexeme);
-        tok->lexeme = NULL;
-    }
+    Token t = scanner_next();
+    if (t.type == TOK_ERROR)
+        error_exit(1, "Lexical error: %s\n", t.lexeme ? t.lexeme : "");
+    return t;
 }
 
 static ASTNode *make_ast_node_for_token(const Token *tok)
@@ -118,7 +134,7 @@ static ASTNode *make_ast_node_for_token(const Token *tok)
         return ast_new(AST_IDENTIFIER, (Token *)tok);
 
     case TOK_KEYWORD:
-        if (tok->lexeme && strcmp(tok->lexeme, "is") == 0)
+        if (tok->keyword == KW_IS)
             return ast_new(AST_EXPR, (Token *)tok);
         return ast_new(AST_IDENTIFIER, (Token *)tok);
 
@@ -139,6 +155,282 @@ static ASTNode *make_ast_node_for_token(const Token *tok)
     }
 }
 
+// pushes `tok`, or the parsed Ifj call it stands for, and tracks '(' nesting
+static void shift_terminal(const Token *tok, int is_call, ASTNode *call,
+                           int build_ast, int *depth)
+{
+    ASTNode *node = NULL;
+    if (is_call)
+        node = call;
+    else if (build_ast)
+        node = make_ast_node_for_token(tok);
+
+    if (!is_call && tok->type == TOK_LPAREN)
+        (*depth)++;
+    else if (!is_call && tok->type == TOK_RPAREN)
+        (*depth)--;
+
+    stack_push_terminal(tok, node);
+}
+
+// -------------------- Constant folding --------------------
+// `E op E` with two literal operands is evaluated while reducing, using
+// the same rules as the generated code. Anything that would fail at run
+// time (type mismatch, division by zero, bad repetition count) is left
+// unfolded so the program still stops with the right exit code.
+
+// longest string a repetition may fold into, bigger ones stay runtime
+#define PSA_FOLD_MAX_STRING 4096
+
+typedef enum {
+    FV_INT,
+    FV_FLOAT,
+    FV_STRING,
+    FV_NULL,
+    FV_BOOL
+} FoldKind;
+
+typedef struct {
+    FoldKind kind;
+    long long i;
+    double f;
+    const char *s;
+    bool b;
+} FoldValue;
+
+static bool fold_value_of(const ASTNode *n, FoldValue *v)
+{
+    const Token *t = n->token;
+    if (!t || n->child_count != 0)
+        return false;
+
+    if (n->type == AST_LITERAL) {
+        switch (t->type) {
+        case TOK_INT:    v->kind = FV_INT;    v->i = strtoll(t->lexeme, NULL, 10); return true;
+        case TOK_HEX:    v->kind = FV_INT;    v->i = strtoll(t->lexeme, NULL, 16); return true;
+        case TOK_FLOAT:  v->kind = FV_FLOAT;  v->f = strtod(t->lexeme, NULL);     return true;
+        case TOK_STRING: v->kind = FV_STRING; v->s = t->lexeme;                   return true;
+        case TOK_BOOL:   v->kind = FV_BOOL;   v->b = t->lexeme[0] == 't';         return true;
+        default:         return false;
+        }
+    }
+
+    if (n->type == AST_IDENTIFIER && t->type == TOK_KEYWORD && t->keyword == KW_NULL) {
+        v->kind = FV_NULL;
+        return true;
+    }
+    return false;
+}
+
+static ASTNode *fold_node(const FoldValue *v)
+{
+    char buf[64];
+    Token tok = { .keyword = KW_NONE };
+    unsigned char mask;
+
+    switch (v->kind) {
+    case FV_INT:
+        tok.type = TOK_INT;
+        snprintf(buf, sizeof buf, "%lld", v->i);
+        tok.lexeme = (char *)intern_cstr(buf);
+        mask = TYPEMASK_INT;
+        break;
+    case FV_FLOAT:
+        // hex keeps the exact value, strtod reads it back
+        tok.type = TOK_FLOAT;
+        snprintf(buf, sizeof buf, "%a", v->f);
+        tok.lexeme = (char *)intern_cstr(buf);
+        mask = TYPEMASK_FLOAT;
+        break;
+    case FV_STRING:
+        tok.type = TOK_STRING;
+        tok.lexeme = (char *)v->s;
+        mask = TYPEMASK_STRING;
+        break;
+    case FV_BOOL:
+        tok.type = TOK_BOOL;
+        tok.lexeme = (char *)(v->b ? "true" : "false");
+        mask = TYPEMASK_BOOL;
+        break;
+    default:
+        return NULL;
+    }
+
+    ASTNode *n = ast_new(AST_LITERAL, &tok);
+    n->type_mask = mask;
+    return n;
+}
+
+static bool fold_is_num(const FoldValue *v)
+{
+    return v->kind == FV_INT || v->kind == FV_FLOAT;
+}
+
+static double fold_as_float(const FoldValue *v)
+{
+    return v->kind == FV_INT ? (double)v->i : v->f;
+}
+
+static bool fold_arith(TokenType op, const FoldValue *a, const FoldValue *b, FoldValue *r)
+{
+    // Num / Num is always a float division
+    if (op == TOK_SLASH) {
+        double d = fold_as_float(b);
+        if (d == 0.0)
+            return false;
+        r->kind = FV_FLOAT;
+        r->f = fold_as_float(a) / d;
+        return true;
+    }
+
+    if (a->kind == FV_INT && b->kind == FV_INT) {
+        r->kind = FV_INT;
+        switch (op) {
+        case TOK_PLUS:  return !__builtin_add_overflow(a->i, b->i, &r->i);
+        case TOK_MINUS: return !__builtin_sub_overflow(a->i, b->i, &r->i);
+        case TOK_STAR:  return !__builtin_mul_overflow(a->i, b->i, &r->i);
+        default:        return false;
+        }
+    }
+
+    r->kind = FV_FLOAT;
+    switch (op) {
+    case TOK_PLUS:  r->f = fold_as_float(a) + fold_as_float(b); return true;
+    case TOK_MINUS: r->f = fold_as_float(a) - fold_as_float(b); return true;
+    case TOK_STAR:  r->f = fold_as_float(a) * fold_as_float(b); return true;
+    default:        return false;
+    }
+}
+
+static bool fold_string(TokenType op, const FoldValue *a, const FoldValue *b, FoldValue *r)
+{
+    size_t alen = strlen(a->s);
+    long long count;
+
+    if (op == TOK_PLUS && b->kind == FV_STRING) {
+        count = 1;
+    } else if (op == TOK_STAR && b->kind == FV_INT) {
+        count = b->i;
+    } else if (op == TOK_STAR && b->kind == FV_FLOAT && b->f == (double)(long long)b->f) {
+        count = (long long)b->f;
+    } else {
+        return false;
+    }
+
+    if (count < 0)
+        return false;
+
+    size_t blen = (op == TOK_PLUS) ? strlen(b->s) : 0;
+    size_t len = (op == TOK_PLUS) ? alen + blen : alen * (size_t)count;
+    if ((alen && (size_t)count > PSA_FOLD_MAX_STRING / alen) || len > PSA_FOLD_MAX_STRING)
+        return false;
+
+    char *buf = malloc(len + 1);
+    if (!buf)
+        error_exit(99, "Out of memory (constant folding)\n");
+
+    if (op == TOK_PLUS) {
+        memcpy(buf, a->s, alen);
+        memcpy(buf + alen, b->s, blen);
+    } else {
+        for (long long k = 0; k < count; k++)
+            memcpy(buf + (size_t)k * alen, a->s, alen);
+    }
+
+    r->kind = FV_STRING;
+    r->s = intern(buf, len);
+    free(buf);
+    return true;
+}
+
+static bool fold_equal(const FoldValue *a, const FoldValue *b)
+{
+    if (fold_is_num(a) && fold_is_num(b)) {
+        if (a->kind == FV_INT && b->kind == FV_INT)
+            return a->i == b->i;
+        return fold_as_float(a) == fold_as_float(b);
+    }
+    if (a->kind != b->kind)
+        return false;
+
+    switch (a->kind) {
+    case FV_STRING: return strcmp(a->s, b->s) == 0;
+    case FV_BOOL:   return a->b == b->b;
+    default:        return true;    // null == null
+    }
+}
+
+// folded replacement for `left op right`, NULL when it must stay at run time
+static ASTNode *psa_fold_constant(ASTNode *op, ASTNode *left, ASTNode *right)
+{
+    const Token *t = op->token;
+    FoldValue a, b, r;
+
+    if (!fold_value_of(left, &a))
+        return NULL;
+
+    if (t->type == TOK_KEYWORD && t->keyword == KW_IS) {
+        const Token *ty = right->token;
+        if (!ty || ty->type != TOK_KEYWORD)
+            return NULL;
+        r.kind = FV_BOOL;
+        switch (ty->keyword) {
+        case KW_Num:    r.b = fold_is_num(&a);      break;
+        case KW_String: r.b = a.kind == FV_STRING;  break;
+        case KW_Null:   r.b = a.kind == FV_NULL;    break;
+        default:        return NULL;
+        }
+        return fold_node(&r);
+    }
+
+    if (!fold_value_of(right, &b))
+        return NULL;
+
+    switch (t->type) {
+    case TOK_PLUS:
+    case TOK_MINUS:
+    case TOK_STAR:
+    case TOK_SLASH:
+        if (a.kind == FV_STRING) {
+            if (!fold_string(t->type, &a, &b, &r))
+                return NULL;
+        } else if (fold_is_num(&a) && fold_is_num(&b)) {
+            if (!fold_arith(t->type, &a, &b, &r))
+                return NULL;
+        } else {
+            return NULL;
+        }
+        break;
+
+    case TOK_LT:
+    case TOK_LE:
+    case TOK_GT:
+    case TOK_GE: {
+        if (!fold_is_num(&a) || !fold_is_num(&b))
+            return NULL;
+        bool both_int = a.kind == FV_INT && b.kind == FV_INT;
+        double x = fold_as_float(&a), y = fold_as_float(&b);
+        int cmp = both_int ? (a.i > b.i) - (a.i < b.i) : (x > y) - (x < y);
+        r.kind = FV_BOOL;
+        r.b = t->type == TOK_LT ? cmp < 0 :
+              t->type == TOK_LE ? cmp <= 0 :
+              t->type == TOK_GT ? cmp > 0 : cmp >= 0;
+        break;
+    }
+
+    case TOK_EQ:
+    case TOK_NE:
+        r.kind = FV_BOOL;
+        r.b = fold_equal(&a, &b) == (t->type == TOK_EQ);
+        break;
+
+    default:
+        return NULL;
+    }
+
+    return fold_node(&r);
+}
+
 // -------------------- Reduce handle (GT case) --------------------
 static PsaResult psa_reduce_handle(int build_ast)
 {
@@ -247,9 +539,17 @@ static PsaResult psa_reduce_handle(int build_ast)
         if (!op || !left || !right)
             return PSA_ERR_INTERNAL;
 
-        ast_add_child(op, left);
-        ast_add_child(op, right);
-        new_node = op;
+        new_node = psa_fold_constant(op, left, right);
+        if (new_node) {
+            // the operands are replaced by the folded literal
+            ast_free(op);
+            ast_free(left);
+            ast_free(right);
+        } else {
+            ast_add_child(op, left);
+            ast_add_child(op, right);
+            new_node = op;
+        }
     }
     else {
         return PSA_ERR_SYNTAX;
@@ -262,8 +562,62 @@ static PsaResult psa_reduce_handle(int build_ast)
     return PSA_OK;
 }
 
+// -------------------- Calls inside expressions --------------------
+// Arguments after an already consumed '(' up to and including ')'.
+// Each one is a nested expression ending at ',' or ')'.
+static PsaResult parse_call_args(ASTNode *call)
+{
+    Token t;
+    do { t = psa_next(); } while (t.type == TOK_EOL);
+
+    if (t.type == TOK_RPAREN)
+        return PSA_OK;
+
+    while (1) {
+        Token end;
+        ASTNode *arg = NULL;
+
+        PsaResult r = psa_parse_expression(t, &end, call ? &arg : NULL);
+        if (r != PSA_OK)
+            return r;
+        if (call)
+            ast_add_child(call, arg);
+
+        if (end.type == TOK_RPAREN)
+            return PSA_OK;
+        if (end.type != TOK_COMMA)
+            return PSA_ERR_SYNTAX;
+
+        do { t = psa_next(); } while (t.type == TOK_EOL);
+    }
+}
+
+// Ifj . name ( args ), `ifj` already read; same shape as parser_func_name()
+static PsaResult parse_builtin_call(const Token *ifj, int build_ast, ASTNode **out)
+{
+    Token dot = psa_next();
+    Token name = psa_next();
+    if (dot.type != TOK_DOT || name.type != TOK_IDENTIFIER)
+        return PSA_ERR_SYNTAX;
+    if (psa_next().type != TOK_LPAREN)
+        return PSA_ERR_SYNTAX;
+
+    ASTNode *call = NULL;
+    if (build_ast) {
+        ASTNode *fname = ast_new(AST_FUNC_NAME, NULL);
+        ast_add_child(fname, ast_new(AST_IDENTIFIER, (Token *)ifj));
+        ast_add_child(fname, ast_new(AST_IDENTIFIER, &name));
+
+        call = ast_new(AST_CALL, NULL);
+        ast_add_child(call, fname);
+    }
+
+    *out = call;
+    return parse_call_args(call);
+}
+
 // -------------------- Main PSA Expression Parser --------------------
-PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
+static PsaResult parse_frame(Token first, Token *out_next, ASTNode **out_ast)
 {
     stack_init();
 
@@ -273,8 +627,9 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
         *out_ast = NULL;
 
     Token bottom_tok;
-    bottom_tok.type   = TOK_EOF;
-    bottom_tok.lexeme = NULL;
+    bottom_tok.type    = TOK_EOF;
+    bottom_tok.keyword = KW_NONE;
+    bottom_tok.lexeme  = NULL;
     stack_push_terminal(&bottom_tok, NULL);
 
     Token current = first;
@@ -291,35 +646,67 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
 
     TokenType last_type = current.type;
     int last_is_is_op =
-        (current.type == TOK_KEYWORD &&
-         current.lexeme &&
-         strcmp(current.lexeme, "is") == 0);
+        (current.type == TOK_KEYWORD && current.keyword == KW_IS);
+
+    int depth = 0;              // open '(' of this expression
+    int pending_call = 0;       // `current` stands for an already parsed Ifj call
+    ASTNode *pending_node = NULL;
 
     while (1)
     {
+        if (!use_pseudo_eof && !pending_call &&
+            current.type == TOK_LPAREN && last_type == TOK_IDENTIFIER) {
+            // ID ( args ): turn the identifier just shifted into a call
+            StackItem *id = stack_top();
+            if (!id || id->kind != SYM_TERMINAL)
+                return PSA_ERR_SYNTAX;
+            if (build_ast)
+                id->node->type = AST_CALL;
+
+            PsaResult r = parse_call_args(build_ast ? id->node : NULL);
+            if (r != PSA_OK)
+                return r;
+
+            last_type = TOK_RPAREN;
+            current = psa_next();
+            continue;
+        }
+
+        if (!use_pseudo_eof && !pending_call &&
+            current.type == TOK_KEYWORD && current.keyword == KW_Ifj) {
+            PsaResult r = parse_builtin_call(&current, build_ast, &pending_node);
+            if (r != PSA_OK)
+                return r;
+            pending_call = 1;
+        }
+
         if (!use_pseudo_eof && current.type == TOK_EOL) {
 
             if (is_op_or_lparen(last_type, last_is_is_op)) {
                 do {
-                    current = scanner_next();
+                    current = psa_next();
                 } while (current.type == TOK_EOL);
                 continue;
             }
 
-            Token la = scanner_next();
+            Token la;
+            do {
+                la = psa_next();
+            } while (la.type == TOK_EOL);
 
-            if (la.type != TOK_EOF) {
+            if (is_binary_op_token(&la)) {
                 current = la;
                 continue;
             }
 
+            // the EOL ends the expression, `la` starts whatever follows
+            scanner_unget(la);
             use_pseudo_eof = 1;
             end_token = current;
         }
 
         StackItem *top_term = stack_top_terminal();
         if (!top_term) {
-            free_token_lexeme(&current);
             return PSA_ERR_INTERNAL;
         }
 
@@ -329,7 +716,7 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
         if (!use_pseudo_eof)
         {
             if (current.type == TOK_SEMICOLON) {
-                Token la = scanner_next();
+                Token la = psa_next();
 
                 if (la.type == TOK_EOL) {
                     use_pseudo_eof = 1;
@@ -342,7 +729,7 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
 
                 g_input = GRP_EOF;
             }
-            else if (is_expr_end_token(current.type))
+            else if (is_expr_end_token(&current, depth))
             {
                 use_pseudo_eof = 1;
                 end_token = current;
@@ -370,27 +757,23 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
                 if (build_ast) {
                     StackItem *top = stack_top();
                     if (!top || top->kind != SYM_NONTERM) {
-                        free_token_lexeme(&current);
                         return PSA_ERR_INTERNAL;
                     }
                     *out_ast = top->node;
                 }
 
-                free_token_lexeme(&current);
                 return PSA_OK;
             }
             else if (rel == GT)
             {
                 PsaResult r = psa_reduce_handle(build_ast);
                 if (r != PSA_OK) {
-                    free_token_lexeme(&current);
                     return r;
                 }
                 continue;
             }
             else
             {
-                free_token_lexeme(&current);
                 return PSA_ERR_SYNTAX;
             }
         }
@@ -401,48 +784,34 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
         {
             stack_insert_marker_after_top_terminal();
             if (use_pseudo_eof) {
-                free_token_lexeme(&current);
                 return PSA_ERR_INTERNAL;
             }
 
-            ASTNode *node = NULL;
-            if (build_ast)
-                node = make_ast_node_for_token(&current);
-
-            stack_push_terminal(&current, node);
-
-            free_token_lexeme(&current);
+            shift_terminal(&current, pending_call, pending_node, build_ast, &depth);
 
-            last_type = current.type;
-            last_is_is_op = (current.type == TOK_KEYWORD &&
-                             current.lexeme &&
-                             strcmp(current.lexeme, "is") == 0);
+            last_type = pending_call ? TOK_RPAREN : current.type;
+            last_is_is_op = (current.type == TOK_KEYWORD && current.keyword == KW_IS);
+            pending_call = 0;
+            pending_node = NULL;
 
-            current = scanner_next();
+            current = psa_next();
             break;
         }
 
         case EQ:
         {
             if (use_pseudo_eof) {
-                free_token_lexeme(&current);
                 return PSA_ERR_SYNTAX;
             }
 
-            ASTNode *node = NULL;
-            if (build_ast)
-                node = make_ast_node_for_token(&current);
-
-            stack_push_terminal(&current, node);
+            shift_terminal(&current, pending_call, pending_node, build_ast, &depth);
 
-            free_token_lexeme(&current);
+            last_type = pending_call ? TOK_RPAREN : current.type;
+            last_is_is_op = (current.type == TOK_KEYWORD && current.keyword == KW_IS);
+            pending_call = 0;
+            pending_node = NULL;
 
-            last_type = current.type;
-            last_is_is_op = (current.type == TOK_KEYWORD &&
-                             current.lexeme &&
-                             strcmp(current.lexeme, "is") == 0);
-
-            current = scanner_next();
+            current = psa_next();
             break;
         }
 
@@ -450,7 +819,6 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
         {
             PsaResult r = psa_reduce_handle(build_ast);
             if (r != PSA_OK) {
-                free_token_lexeme(&current);
                 return r;
             }
             break;
@@ -458,8 +826,15 @@ PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
 
         case UD:
         default:
-            free_token_lexeme(&current);            
             return PSA_ERR_SYNTAX;
         }
     }
 }
+
+PsaResult psa_parse_expression(Token first, Token *out_next, ASTNode **out_ast)
+{
+    int outer = stack_frame_push();
+    PsaResult r = parse_frame(first, out_next, out_ast);
+    stack_frame_pop(outer);
+    return r;
+}
@@ -5,6 +5,10 @@
 #include "scanner.h"
 #include "psa.h"
 #include "ast.h"
+#include "symtable.h"
+
+// psa.c links against the parser, which registers into this table
+SymTable *g_global_symtable = NULL;
 
 // ------------------------------------------------------------
 // Token → text
@@ -20,6 +24,7 @@ static const char *token_type_name(TokenType t)
     case TOK_FLOAT:       return "FLOAT";
     case TOK_HEX:         return "HEX";
     case TOK_STRING:      return "STRING";
+    case TOK_BOOL:        return "BOOL";
     case TOK_PLUS:        return "PLUS";
     case TOK_MINUS:       return "MINUS";
     case TOK_STAR:        return "STAR";
@@ -242,6 +247,8 @@ void ast_print_pretty(ASTNode *n, const char *prefix, int is_last)
 typedef struct {
     const char *name;
     const char *input;
+    const char *expect;     // S-expression of the resulting tree, NULL = not checked
+    const char *literal;    // token type of a folded result, NULL = not checked
 } AstPsaTest;
 
 static int run_one_ast_test(const AstPsaTest *tc)
@@ -274,17 +281,27 @@ static int run_one_ast_test(const AstPsaTest *tc)
     ASTNode *root = NULL;
 
     PsaResult res = psa_parse_expression(first, &end_tok, &root);
-    int pass = (res == PSA_OK && root != NULL);
+    char *sexpr = (res == PSA_OK && root) ? ast_to_sexpr(root) : NULL;
+    const char *lit = (root && root->type == AST_LITERAL && root->token)
+                      ? token_type_name(root->token->type) : NULL;
+
+    int pass = sexpr && (!tc->expect || strcmp(sexpr, tc->expect) == 0) &&
+               (!tc->literal || (lit && strcmp(lit, tc->literal) == 0));
 
     printf("[%-20s] %s\n", tc->name, pass ? "PASS" : "FAIL");
     printf("    input       : \"%s\"\n", tc->input);
     printf("    result      : %s\n", psa_result_name(res));
+    printf("    expected    : %s", tc->expect ? tc->expect : "<any>");
+    if (tc->literal)
+        printf(" (%s)", tc->literal);
+    printf("\n");
 
     if (res == PSA_OK) {
         printf("    end token   : %s\n", token_type_name(end_tok.type));
-
-        char *sexpr = ast_to_sexpr(root);
-        printf("    AST S-expr  : %s\n", sexpr);
+        printf("    AST S-expr  : %s", sexpr);
+        if (lit)
+            printf(" (%s)", lit);
+        printf("\n");
         free(sexpr);
 
         printf("    AST STROM:\n");
@@ -300,18 +317,45 @@ static int run_one_ast_test(const AstPsaTest *tc)
 
 int main(void)
 {
+    // operands are identifiers wherever the tree shape is under test,
+    // literal operands would be folded away
     const AstPsaTest tests[] = {
-        { "lit_simple",         "1;" },
-        { "ident_simple",       "a;" },
-        { "arith_precedence",   "1 + 2 * 3;" },
-        { "arith_parens",       "(1 + 2) * 3;" },
-        { "idents_mul",         "a + b * c;" },
-        { "rel_eq",             "a < b == c;" },
-        { "is_num",             "a is Num;" },
-        { "rel_is_eq_chain",    "a < b is Num == c != d;" },
-        { "multiline_plus",     "1 +\n2;" },
-        { "multiline_long",     "a +\n b * c\n - d / (e +\n f);\n" },
-        { "deep_parens",        "(((a + b))) * c;" },
+        { "lit_simple",         "1;",                      "1",               NULL },
+        { "ident_simple",       "a;",                      "a",               NULL },
+        { "arith_precedence",   "a + b * c;",              "(+ a (* b c))",   NULL },
+        { "arith_parens",       "(a + b) * c;",            "(* (+ a b) c)",   NULL },
+        { "arith_left_assoc",   "a - b - c;",              "(- (- a b) c)",   NULL },
+        { "rel_eq",             "a < b == c;",             "(== (< a b) c)",  NULL },
+        { "is_num",             "a is Num;",               "(is a Num)",      NULL },
+        { "rel_is_eq_chain",    "a < b is Num == c != d;",
+                                "(!= (== (is (< a b) Num) c) d)", NULL },
+        { "multiline_plus",     "a +\nb;",                 "(+ a b)",         NULL },
+        { "multiline_long",     "a +\n b * c\n - d / (e +\n f);\n",
+                                "(- (+ a (* b c)) (/ d (+ e f)))", NULL },
+        { "deep_parens",        "(((a + b))) * c;",        "(* (+ a b) c)",   NULL },
+
+        // constant folding
+        { "fold_nested",        "(1 + 2) * (10 - 3);",     "21",              "INT" },
+        { "fold_partial",       "a + 2 * 3;",              "(+ a 6)",         NULL },
+        { "fold_int_div",       "7 / 2;",                  "0x1.cp+1",        "FLOAT" },
+        { "fold_mixed",         "1 + 0.5;",                "0x1.8p+0",        "FLOAT" },
+        { "fold_str_concat",    "\"ab\" + \"cd\";",        "abcd",            "STRING" },
+        { "fold_str_repeat",    "\"ab\" * 3;",             "ababab",          "STRING" },
+        { "fold_str_nested",    "\"x\" * 2 + \"y\";",      "xxy",             "STRING" },
+        { "fold_div_zero",      "x / 0;",                  "(/ x 0)",         NULL },
+        { "fold_lit_div_zero",  "1 / 0;",                  "(/ 1 0)",         NULL },
+        { "fold_int_overflow",  "9223372036854775807 + 1;",
+                                "(+ 9223372036854775807 1)", NULL },
+        { "fold_mul_overflow",  "4611686018427387904 * 2;",
+                                "(* 4611686018427387904 2)", NULL },
+        { "fold_repeat_limit",  "\"ab\" * 2049;",          "(* ab 2049)",     NULL },
+        { "fold_repeat_max",    "\"ab\" * 2048;",          NULL,              "STRING" },
+        { "fold_repeat_neg",    "\"ab\" * (0 - 1);",       "(* ab -1)",       NULL },
+        { "fold_type_error",    "\"a\" - 1;",              "(- a 1)",         NULL },
+        { "fold_rel",           "1 < 2;",                  "true",            "BOOL" },
+        { "fold_rel_mixed",     "2.5 >= 3;",               "false",           "BOOL" },
+        { "fold_eq_chain",      "1 + 1 == 2;",             "true",            "BOOL" },
+        { "fold_is",            "\"s\" is String;",        "true",            "BOOL" },
     };
 
     int count = (int)(sizeof(tests) / sizeof(tests[0]));
@@ -323,5 +367,5 @@ int main(void)
     printf("AST+PSA visual test summary: %d / %d passed\n",
            passed, count);
 
-    return 0;
+    return passed == count ? 0 : 1;
 }
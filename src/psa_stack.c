@@ -4,15 +4,29 @@
 
 static StackItem stack[256];
 static int sp = -1;
+static int base = 0;    // first slot of the innermost frame
 
 void stack_init(void)
 {
-    sp = -1;
+    sp = base - 1;
 }
 
 void stack_clear(void)
 {
-    sp = -1;
+    sp = base - 1;
+}
+
+int stack_frame_push(void)
+{
+    int outer = base;
+    base = sp + 1;
+    return outer;
+}
+
+void stack_frame_pop(int outer)
+{
+    sp = base - 1;
+    base = outer;
 }
 
 void stack_push_terminal(const Token *tok, ASTNode *node)
@@ -62,7 +76,7 @@ void stack_push_marker(void)
 
 StackItem stack_pop(void)
 {
-    if (sp < 0) {
+    if (sp < base) {
         fprintf(stderr, "PSA stack underflow\n");
         exit(1);
     }
@@ -71,13 +85,13 @@ StackItem stack_pop(void)
 
 StackItem *stack_top(void)
 {
-    if (sp < 0) return NULL;
+    if (sp < base) return NULL;
     return &stack[sp];
 }
 
 StackItem *stack_top_terminal(void)
 {
-    for (int i = sp; i >= 0; --i) {
+    for (int i = sp; i >= base; --i) {
         if (stack[i].kind == SYM_TERMINAL)
             return &stack[i];
     }
@@ -92,7 +106,7 @@ void stack_insert_marker_after_top_terminal(void)
     }
 
     int idx = -1;
-    for (int i = sp; i >= 0; --i) {
+    for (int i = sp; i >= base; --i) {
         if (stack[i].kind == SYM_TERMINAL) {
             idx = i;
             break;
@@ -118,16 +132,16 @@ void stack_insert_marker_after_top_terminal(void)
 
 int stack_size(void)
 {
-    return sp + 1;
+    return sp + 1 - base;
 }
 
 int stack_is_eof_with_E_on_top(void)
 {
-    if (sp != 1) return 0;
+    if (sp != base + 1) return 0;
 
-    if (stack[0].kind == SYM_TERMINAL &&
-        stack[0].tok_type == TOK_EOF &&
-        stack[1].kind == SYM_NONTERM)
+    if (stack[base].kind == SYM_TERMINAL &&
+        stack[base].tok_type == TOK_EOF &&
+        stack[base + 1].kind == SYM_NONTERM)
         return 1;
 
     return 0;
@@ -30,6 +30,10 @@ typedef struct {
 void stack_init(void);
 void stack_clear(void);
 
+// nested expressions (call arguments) run in their own frame on the same stack
+int  stack_frame_push(void);
+void stack_frame_pop(int outer);
+
 void stack_push_terminal(const Token *tok, ASTNode *node);
 void stack_push_nonterm(ExprType type, ASTNode *node);
 void stack_push_marker(void);
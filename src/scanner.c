@@ -6,22 +6,41 @@
 
 #include "scanner.h"
 #include "token.h"
+#include "intern.h"
 
-#define INITIAL_BUF_SIZE 64
+#define LEX_CHUNK_SIZE 4096
 
 static FILE *input = NULL;
 int current_char = ' ';
 
-static char *cstrdup(const char *s);
+// Whole-file input: seekable sources are read once into src_buf and
+// advance() only bumps src_pos; stdin/pipes keep using fgetc(input).
+static char *src_buf = NULL;
+static const char *src_pos = NULL;
+static const char *src_end = NULL;
+static size_t stream_consumed = 0;   // characters read through fgetc()
+static size_t tok_start = 0;         // source offset of the token being scanned
+
+// one token of pushback for scanner_unget()
+static Token pushed_back;
+static bool has_pushed_back = false;
+
+typedef struct LexChunk
+{
+    struct LexChunk *next;
+    size_t cap;
+    size_t used;
+    char data[];
+} LexChunk;
 
 // -------------------- Macro for repeated pattern --------------------
 // Append character, advance, and change state
-#define APPEND_ADVANCE_STATE(LEX, LEN, CAP, CH, NEXT_STATE) \
-    do                                                      \
-    {                                                       \
-        buffer_append((LEX), (LEN), (CAP), (CH));           \
-        advance();                                          \
-        state = (NEXT_STATE);                               \
+#define APPEND_ADVANCE_STATE(CH, NEXT_STATE) \
+    do                                       \
+    {                                        \
+        lex_putc(CH);                        \
+        advance();                           \
+        state = (NEXT_STATE);                \
     } while (0)
 
 // For single-character literals
@@ -29,7 +48,6 @@ static char *cstrdup(const char *s);
     do                                 \
     {                                  \
         advance();                     \
-        free(lex);                     \
         return make_token(TYPE, NULL); \
     } while (0)
 
@@ -58,56 +76,138 @@ static char *cstrdup(const char *s);
         advance();                                    \
     }
 // -------------------- Utility Functions --------------------
-static void advance() { current_char = fgetc(input); }
-static int peek() { return current_char; }
+static inline void advance()
+{
+    if (src_buf)
+        current_char = src_pos < src_end ? (unsigned char)*src_pos++ : EOF;
+    else if ((current_char = fgetc(input)) != EOF)
+        stream_consumed++;
+}
+static inline int peek() { return current_char; }
 
-void scanner_init(FILE *in)
+// Un-read the current lookahead and make `c` the current character again
+static void putback(int c)
 {
-    input = in;
-    current_char = ' ';
-    advance();
+    if (src_buf)
+    {
+        if (current_char != EOF)
+            src_pos--;
+    }
+    else if (current_char != EOF)
+    {
+        ungetc(current_char, input);
+        stream_consumed--;
+    }
+    current_char = c;
 }
 
-static Token make_token(TokenType type, char *lexeme)
+// Read the whole input into src_buf; returns false for non-seekable streams
+static bool load_source(FILE *in)
 {
-    Token t;
-    t.type = type;
-    t.lexeme = lexeme;
-    return t;
+    if (fseek(in, 0, SEEK_END) != 0)
+        return false;
+    long size = ftell(in);
+    if (size < 0 || fseek(in, 0, SEEK_SET) != 0)
+        return false;
+
+    src_buf = malloc((size_t)size + 1);
+    if (!src_buf)
+    {
+        fprintf(stderr, "Fatal: Out of memory in lexer\n");
+        exit(99);
+    }
+    size_t got = fread(src_buf, 1, (size_t)size, in);
+    src_buf[got] = '\0';
+
+    src_pos = src_buf;
+    src_end = src_buf + got;
+    return true;
 }
 
-static Token make_error(const char *msg)
+// -------------------- Lexeme pool --------------------
+// Lexemes are built in scanner-owned chunks. Only decoded string literals
+// stay there (valid until scanner_free()); identifiers and numbers are
+// interned and their space is reused by the next token. A decoded string
+// plus its NUL is never longer than its quoted source text, so a buffered
+// source gets one chunk the size of the file and scanning does not
+// allocate per token.
+static LexChunk *lex_chunks = NULL;
+static char *lex_start = NULL;
+static size_t lex_len = 0;
+
+static LexChunk *lex_chunk_new(size_t cap, LexChunk *next)
+{
+    LexChunk *c = malloc(sizeof(LexChunk) + cap);
+    if (!c)
+    {
+        fprintf(stderr, "Fatal: Out of memory in lexer\n");
+        exit(99);
+    }
+    c->next = next;
+    c->cap = cap;
+    c->used = 0;
+    return c;
+}
+
+static void lex_begin(void)
 {
-    return make_token(TOK_ERROR, cstrdup(msg));
+    lex_start = lex_chunks->data + lex_chunks->used;
+    lex_len = 0;
 }
 
-static void buffer_append(char **buf, size_t *len, size_t *cap, char c)
+static void lex_putc(char c)
 {
-    if (*len + 1 >= *cap)
+    if (lex_chunks->used + lex_len + 1 >= lex_chunks->cap)
     {
-        *cap *= 2;
-        char *tmp = realloc(*buf, *cap);
-        if (!tmp)
-        {
-            fprintf(stderr, "Fatal: Out of memory in lexer\n");
-            free(*buf);
-            exit(1);
-        }
-        *buf = tmp;
+        size_t cap = LEX_CHUNK_SIZE;
+        while (cap < 2 * (lex_len + 1))
+            cap *= 2;
+        lex_chunks = lex_chunk_new(cap, lex_chunks);
+        memcpy(lex_chunks->data, lex_start, lex_len);
+        lex_start = lex_chunks->data;
     }
-    (*buf)[(*len)++] = c;
-    (*buf)[*len] = '\0';
+    lex_start[lex_len++] = c;
+}
+
+// Terminate the lexeme being built and keep it in the pool
+static char *lex_finish(void)
+{
+    char *text = lex_start;
+    text[lex_len] = '\0';
+    lex_chunks->used += lex_len + 1;
+    lex_begin();
+    return text;
+}
+
+// Identifiers and numbers go to the interner instead of the pool
+static char *lex_intern(void)
+{
+    char *text = (char *)intern(lex_start, lex_len);
+    lex_begin();
+    return text;
+}
+
+// Source offset of current_char
+static size_t cur_offset(void)
+{
+    size_t consumed = src_buf ? (size_t)(src_pos - src_buf) : stream_consumed;
+    return current_char == EOF ? consumed : consumed - 1;
+}
+
+static Token make_token(TokenType type, char *lexeme)
+{
+    Token t;
+    t.type = type;
+    t.keyword = KW_NONE;
+    t.lexeme = lexeme;
+    t.offset = tok_start;
+    t.length = cur_offset() - tok_start;
+    return t;
 }
 
-static char *cstrdup(const char *s)
+static Token make_error(const char *msg)
 {
-    if (!s)
-        return NULL;
-    size_t len = strlen(s) + 1;
-    char *p = malloc(len);
-    if (p)
-        memcpy(p, s, len);
-    return p;
+    return make_token(TOK_ERROR, (char *)msg);
 }
 
 // -------------------- Whitespace & Comment Handling --------------------
@@ -173,7 +273,7 @@ static Token skip_whitespace()
             }
             else
             {
-                current_char = '/'; // put back the '/'
+                putback('/');
                 return make_token(TOK_WS, NULL);
             }
         }
@@ -183,30 +283,111 @@ static Token skip_whitespace()
 }
 
 // -------------------- Keyword checking --------------------
-static bool is_keyword(const char *lex)
+// Dispatch on length and first character, then one memcmp at most
+#define KW_MATCH(WORD, KIND) \
+    (memcmp(s, WORD, sizeof(WORD) - 1) == 0 ? (KIND) : KW_NONE)
+
+static KeywordKind keyword_lookup(const char *s, size_t len)
 {
-    static const char *keywords[] = {
-        "class", "if", "else", "is", "null", "return", "var", "while", "static", "import", "for",
-        "Num", "String", "Null", "Ifj"};
-    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
-        if (strcmp(lex, keywords[i]) == 0)
-            return true;
-    return false;
+    switch (len)
+    {
+    case 2:
+        switch (s[0])
+        {
+        case 'i': return s[1] == 'f' ? KW_IF : s[1] == 's' ? KW_IS : KW_NONE;
+        }
+        break;
+    case 3:
+        switch (s[0])
+        {
+        case 'v': return KW_MATCH("var", KW_VAR);
+        case 'f': return KW_MATCH("for", KW_FOR);
+        case 'N': return KW_MATCH("Num", KW_Num);
+        case 'I': return KW_MATCH("Ifj", KW_Ifj);
+        }
+        break;
+    case 4:
+        switch (s[0])
+        {
+        case 'e': return KW_MATCH("else", KW_ELSE);
+        case 'n': return KW_MATCH("null", KW_NULL);
+        case 'N': return KW_MATCH("Null", KW_Null);
+        }
+        break;
+    case 5:
+        switch (s[0])
+        {
+        case 'c': return KW_MATCH("class", KW_CLASS);
+        case 'w': return KW_MATCH("while", KW_WHILE);
+        }
+        break;
+    case 6:
+        switch (s[0])
+        {
+        case 'r': return KW_MATCH("return", KW_RETURN);
+        case 's': return KW_MATCH("static", KW_STATIC);
+        case 'i': return KW_MATCH("import", KW_IMPORT);
+        case 'S': return KW_MATCH("String", KW_String);
+        }
+        break;
+    }
+    return KW_NONE;
+}
+
+void scanner_init(FILE *in)
+{
+    scanner_free();
+    input = in;
+    stream_consumed = 0;
+    has_pushed_back = false;
+    if (load_source(in))
+        lex_chunks = lex_chunk_new((size_t)(src_end - src_buf) + 2, NULL);
+    else
+    {
+        clearerr(in);
+        lex_chunks = lex_chunk_new(LEX_CHUNK_SIZE, NULL);
+    }
+    lex_begin();
+    current_char = ' ';
+    advance();
+}
+
+// Releases the source buffer and every lexeme handed out in tokens
+void scanner_free(void)
+{
+    free(src_buf);
+    src_buf = NULL;
+    src_pos = src_end = NULL;
+
+    while (lex_chunks)
+    {
+        LexChunk *next = lex_chunks->next;
+        free(lex_chunks);
+        lex_chunks = next;
+    }
+    lex_start = NULL;
+    lex_len = 0;
 }
 
 // -------------------- Main Scanner --------------------
-Token scanner_next()
+void scanner_unget(Token t)
 {
-    LexerState state = STATE_START;
+    pushed_back = t;
+    has_pushed_back = true;
+}
 
-    size_t len = 0, cap = INITIAL_BUF_SIZE;
-    char *lex = malloc(cap);
-    if (!lex)
+Token scanner_next()
+{
+    if (has_pushed_back)
     {
-        fprintf(stderr, "Out of memory\n");
-        exit(1);
+        has_pushed_back = false;
+        return pushed_back;
     }
-    lex[0] = '\0';
+
+    LexerState state = STATE_START;
+
+    tok_start = cur_offset();
+    lex_begin();
 
     while (1)
     {
@@ -219,31 +400,30 @@ Token scanner_next()
 
             if (tmp_token.type == TOK_EOL)
             {
-                free(lex);
                 return tmp_token;
             }
 
             if (tmp_token.type == TOK_ERROR)
             {
-                free(lex);
                 return tmp_token;
             }
 
+            tok_start = cur_offset();
             if (peek() == EOF)
                 RETURN_SINGLE_CHAR_TOKEN(TOK_EOF);
             if (peek() == '0')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '0', STATE_SINGLE_ZERO);
+                APPEND_ADVANCE_STATE('0', STATE_SINGLE_ZERO);
                 break;
             }
             else if (isdigit(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_INT);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_INT);
                 break;
             }
             else if (isalpha(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_ID);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_ID);
                 break;
             }
             else if (peek() == '"')
@@ -257,13 +437,12 @@ Token scanner_next()
                 advance();
                 if (peek() == '_')
                 {
-                    buffer_append(&lex, &len, &cap, '_');
-                    APPEND_ADVANCE_STATE(&lex, &len, &cap, '_', STATE_PRE_GID);
+                    lex_putc('_');
+                    APPEND_ADVANCE_STATE('_', STATE_PRE_GID);
                     break;
                 }
                 else
                 {
-                    free(lex);
                     RECOVER_UNTIL_SAFE();
                     return make_error("Identifiers cannot start with single '_'");
                 }
@@ -284,13 +463,12 @@ Token scanner_next()
                 advance();
                 if (peek() == '=')
                     RETURN_SINGLE_CHAR_TOKEN(TOK_EQ);
-                RETURN_SINGLE_CHAR_TOKEN(TOK_ASSIGN);
+                return make_token(TOK_ASSIGN, NULL); // lookahead already consumed
 
             case '!':
                 advance();
                 if (peek() == '=')
                     RETURN_SINGLE_CHAR_TOKEN(TOK_NE);
-                free(lex);
                 RECOVER_UNTIL_SAFE();
                 return make_error("Unexpected '!': did you mean '!=' ?");
 
@@ -298,13 +476,13 @@ Token scanner_next()
                 advance();
                 if (peek() == '=')
                     RETURN_SINGLE_CHAR_TOKEN(TOK_LE);
-                RETURN_SINGLE_CHAR_TOKEN(TOK_LT);
+                return make_token(TOK_LT, NULL); // lookahead already consumed
 
             case '>':
                 advance();
                 if (peek() == '=')
                     RETURN_SINGLE_CHAR_TOKEN(TOK_GE);
-                RETURN_SINGLE_CHAR_TOKEN(TOK_GT);
+                return make_token(TOK_GT, NULL); // lookahead already consumed
 
             case '(':
                 RETURN_SINGLE_CHAR_TOKEN(TOK_LPAREN);
@@ -326,7 +504,6 @@ Token scanner_next()
                 RETURN_SINGLE_CHAR_TOKEN(TOK_QUESTION);
 
             default:
-                free(lex);
                 advance();
                 RECOVER_UNTIL_SAFE();
                 return make_error("Unexpected character");
@@ -335,131 +512,130 @@ Token scanner_next()
         case STATE_PRE_GID:
             if (isalnum(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_GID);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_GID);
                 break;
             }
-            free(lex);
             RECOVER_UNTIL_SAFE();
             return make_error("Invalid character after \"__\" ");
 
         case STATE_GID:
             while (isalnum(peek()) || peek() == '_')
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
-            return make_token(TOK_GID, lex); // ownership of lex passed
+            return make_token(TOK_GID, lex_intern());
 
         case STATE_ID:
             while (isalnum(peek()) || peek() == '_')
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
-            if (is_keyword(lex))
-                return make_token(TOK_KEYWORD, lex);
-            return make_token(TOK_IDENTIFIER, lex);
+        {
+            KeywordKind kw = keyword_lookup(lex_start, lex_len);
+            Token t = make_token(kw != KW_NONE ? TOK_KEYWORD : TOK_IDENTIFIER, lex_intern());
+            t.keyword = kw;
+            return t;
+        }
 
         case STATE_SINGLE_ZERO:
         //TOTO decide how to handle 0-prefixed numbers
             if (peek() == 'x')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_HEX);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_HEX);
                 break;
             }
             if (peek() == 'e' || peek() == 'E')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_EXP);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_EXP);
                 break;
             }
             if (peek() == '.')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_FLOAT);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_FLOAT);
                 break;
             }
-            return make_token(TOK_INT, lex);
+            return make_token(TOK_INT, lex_intern());
 
         case STATE_PRE_HEX:
             if (isxdigit(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_HEX);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_HEX);
                 break;
             }
-            free(lex);
             RECOVER_UNTIL_SAFE();
             return make_error("Invalid hexadecimal int format");
 
         case STATE_HEX:
             while (isxdigit(peek()))
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
-            return make_token(TOK_HEX, lex);
+            return make_token(TOK_HEX, lex_intern());
 
         case STATE_PRE_FLOAT:
             if (isdigit(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_FLOAT);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_FLOAT);
                 break;
             }
-            free(lex);
             RECOVER_UNTIL_SAFE();
             return make_error("Invalid decimal format");
 
         case STATE_FLOAT:
             while (isdigit(peek()))
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
             if (peek() == 'e' || peek() == 'E')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_EXP);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_EXP);
                 break;
             }
-            return make_token(TOK_FLOAT, lex);
+            return make_token(TOK_FLOAT, lex_intern());
 
         case STATE_PRE_EXP:
             if (peek() == '+' || peek() == '-')
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
             if (isdigit(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_EXP);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_EXP);
                 break;
             }
-            free(lex);
             RECOVER_UNTIL_SAFE();
             return make_error("Invalid exponential format");
 
         case STATE_EXP:
             while (isdigit(peek()))
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
-            return make_token(TOK_FLOAT, lex);
+            return make_token(TOK_FLOAT, lex_intern());
 
         case STATE_INT:
             if (peek() == '.')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_FLOAT);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_FLOAT);
                 break;
             }
             if (peek() == 'e' || peek() == 'E')
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_PRE_EXP);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_PRE_EXP);
                 break;
             }
             if (isdigit(peek()))
             {
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, (char)peek(), STATE_INT);
+                APPEND_ADVANCE_STATE((char)peek(), STATE_INT);
                 break;
             }
-            return make_token(TOK_INT, lex);
+            return make_token(TOK_INT, lex_intern());
 
         case STATE_PRE_STRING:
             // check for triple quotes -> multiline string
@@ -475,8 +651,7 @@ Token scanner_next()
                 else
                 {
                     // It was an empty string ""
-                    free(lex);
-                    return make_token(TOK_STRING, cstrdup(""));
+                    return make_token(TOK_STRING, lex_finish());
                 }
             }
             // normal single-line string
@@ -486,7 +661,6 @@ Token scanner_next()
         case STATE_IN_STRING:
             if (peek() == '\n' || peek() == EOF)
             {
-                free(lex);
                 RECOVER_STRING();
                 return make_error("Unterminated string literal");
             }
@@ -499,15 +673,14 @@ Token scanner_next()
             if (peek() == '"')
             {
                 advance();
-                return make_token(TOK_STRING, lex);
+                return make_token(TOK_STRING, lex_finish());
             }
             if (peek() > 31)
             {
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
                 break;
             }
-            free(lex);
 
             RECOVER_STRING();
 
@@ -516,25 +689,24 @@ Token scanner_next()
         case STATE_ESC:
             if (peek() == EOF)
             {
-                free(lex);
                 return make_error("Unterminated escape sequence");
             }
             switch (peek())
             {
             case 'n':
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '\n', STATE_IN_STRING);
+                APPEND_ADVANCE_STATE('\n', STATE_IN_STRING);
                 break;
             case 'r':
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '\r', STATE_IN_STRING);
+                APPEND_ADVANCE_STATE('\r', STATE_IN_STRING);
                 break;
             case 't':
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '\t', STATE_IN_STRING);
+                APPEND_ADVANCE_STATE('\t', STATE_IN_STRING);
                 break;
             case '\\':
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '\\', STATE_IN_STRING);
+                APPEND_ADVANCE_STATE('\\', STATE_IN_STRING);
                 break;
             case '"':
-                APPEND_ADVANCE_STATE(&lex, &len, &cap, '"', STATE_IN_STRING);
+                APPEND_ADVANCE_STATE('"', STATE_IN_STRING);
                 break;
             case 'x':
             {
@@ -545,7 +717,6 @@ Token scanner_next()
                 advance();
                 if (!isxdigit(h1) || !isxdigit(h2))
                 {
-                    free(lex);
 
                     RECOVER_STRING();   
 
@@ -554,12 +725,11 @@ Token scanner_next()
                 char hexbuf[3] = {(char)h1, (char)h2, 0};
                 unsigned value = 0;
                 sscanf(hexbuf, "%x", &value);
-                buffer_append(&lex, &len, &cap, (char)value);
+                lex_putc((char)value);
                 state = STATE_IN_STRING;
                 break;
             }
             default:
-                free(lex);
 
                 RECOVER_STRING();
 
@@ -568,7 +738,7 @@ Token scanner_next()
             break;
         case STATE_MULTIL_STRING:
         {
-            int line_start = 0;
+            size_t line_start = 0;
 
             bool is_first_line = true;
             while (peek() != EOF)
@@ -593,9 +763,9 @@ Token scanner_next()
 
                                 // detect if all chars are whitespace
                                 bool only_ws = true;
-                                for (size_t i = 0; i < len; i++)
+                                for (size_t i = 0; i < lex_len; i++)
                                 {
-                                    if (!isspace(lex[i]))
+                                    if (!isspace((unsigned char)lex_start[i]))
                                     {
                                         only_ws = false;
                                         break;
@@ -603,14 +773,8 @@ Token scanner_next()
                                 }
 
                                 if (only_ws)
-                                {
-                                    free(lex);
-                                    return make_token(TOK_STRING, cstrdup(""));
-                                }
-                                else
-                                {
-                                    return make_token(TOK_STRING, lex);
-                                }
+                                    lex_len = 0;
+                                return make_token(TOK_STRING, lex_finish());
                             }
 
                             /* -----------------------------------------
@@ -618,32 +782,28 @@ Token scanner_next()
                                ----------------------------------------- */
 
                             bool final_blank = true;
-                            for (size_t i = line_start; i < len; i++)
-                                if (!isspace(lex[i]))
+                            for (size_t i = line_start; i < lex_len; i++)
+                                if (!isspace((unsigned char)lex_start[i]))
                                     final_blank = false;
 
                             if (final_blank)
                             {
-                                len = line_start; // remove that line completely
-                                lex[len] = '\0';
+                                lex_len = line_start; // remove that line completely
                             }
 
                             // Finally trim the newline before closing """
-                            if (len > 0 && lex[len - 1] == '\n')
-                            {
-                                len--;
-                                lex[len] = '\0';
-                            }
+                            if (lex_len > 0 && lex_start[lex_len - 1] == '\n')
+                                lex_len--;
 
-                            return make_token(TOK_STRING, lex);
+                            return make_token(TOK_STRING, lex_finish());
                         }
                         // not closing: write `""`
-                        buffer_append(&lex, &len, &cap, '"');
-                        buffer_append(&lex, &len, &cap, '"');
+                        lex_putc('"');
+                        lex_putc('"');
                         continue;
                     }
                     // not closing: write `"`
-                    buffer_append(&lex, &len, &cap, '"');
+                    lex_putc('"');
                     continue;
                 }
 
@@ -653,7 +813,7 @@ Token scanner_next()
                 if (peek() == '\n')
                 {
                     advance();
-                    buffer_append(&lex, &len, &cap, '\n');
+                    lex_putc('\n');
                     if (is_first_line)
                     {
                         // trim the first line (it is never trimmed in single-line mode)
@@ -661,9 +821,9 @@ Token scanner_next()
 
                         // detect if all chars are whitespace
                         bool only_ws = true;
-                        for (size_t i = 0; i < len; i++)
+                        for (size_t i = 0; i < lex_len; i++)
                         {
-                            if (!isspace(lex[i]))
+                            if (!isspace((unsigned char)lex_start[i]))
                             {
                                 only_ws = false;
                                 break;
@@ -671,27 +831,20 @@ Token scanner_next()
                         }
 
                         if (only_ws)
-                        {
-                            while (len > 0)
-                            {
-                                len--;
-                                lex[len] = '\0';
-                            }
-                        }
+                            lex_len = 0;
                     }
                     is_first_line = false;
-                    line_start = len;
+                    line_start = lex_len;
                     continue;
                 }
 
                 /* ---------------------------------------------
                    Any other character → append
                    --------------------------------------------- */
-                buffer_append(&lex, &len, &cap, (char)peek());
+                lex_putc((char)peek());
                 advance();
             }
 
-            free(lex);
             return make_error("Unterminated multiline string literal");
         }
         } // end switch
@@ -5,8 +5,12 @@
 #include "token.h"
 #include <stdio.h>
 
+// Seekable inputs are read once into memory, pipes/stdin are read per character
 void scanner_init(FILE *input);
+void scanner_free(void);
 Token scanner_next();
+// the next scanner_next() returns `t` again (one token deep)
+void scanner_unget(Token t);
 
 
 typedef enum {
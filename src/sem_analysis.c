@@ -51,7 +51,6 @@ static bool        sem_expr(SemContext *ctx, ASTNode *node);
 
 /* helpers */
 static SymInfo    *sem_lookup_var(SemContext *ctx, const char *name);
-static SymInfo    *symtable_find_local(SymTable *table, const char *key);
 static void        sem_register_func_record(SemContext *ctx, SymInfo *sym);
 
 /* ---------------------------------------------------------
@@ -67,7 +66,7 @@ static SemContext *sem_ctx_create(void)
         error_exit(99, "Global symtable not initialized\n");
 
     ctx->global_scope    = g_global_symtable;
-    ctx->current_scope   = ctx->global_scope;
+    scope_init(&ctx->scopes);
     ctx->has_main_noargs = false;
     ctx->func_list       = NULL;
 
@@ -80,12 +79,7 @@ static void sem_ctx_free(SemContext *ctx)
 
     /* Free all scopes created by sem_enter_scope,
        but NOT the global scope (freed in main). */
-    SymTable *t = ctx->current_scope;
-    while (t && t != ctx->global_scope) {
-        SymTable *parent = t->next;
-        symtable_free(t);
-        t = parent;
-    }
+    scope_free(&ctx->scopes);
 
     // free func_list (SymInfo itself is owned by symtable)
     FuncRecord *fr = ctx->func_list;
@@ -100,34 +94,24 @@ static void sem_ctx_free(SemContext *ctx)
 
 static void sem_enter_scope(SemContext *ctx)
 {
-    SymTable *new_scope = symtable_create(ctx->current_scope);
-    if (!new_scope)
-        error_exit(99, "Out of memory (scope)\n");
-    ctx->current_scope = new_scope;
+    scope_enter(&ctx->scopes);
 }
 
 static void sem_leave_scope(SemContext *ctx)
 {
-    SymTable *old    = ctx->current_scope;
-    SymTable *parent = old->next;
-    symtable_free(old);
-    ctx->current_scope = parent;
+    scope_leave(&ctx->scopes);
 }
 
 /* ---------------------------------------------------------
    Helpers
    --------------------------------------------------------- */
 
-static SymInfo *symtable_find_local(SymTable *table, const char *key)
-{
-    if (!table) return NULL;
-    return bst_find(table->root, key);
-}
-
 /* normal scoped lookup (local -> parent -> ...) */
 static SymInfo *sem_lookup_var(SemContext *ctx, const char *name)
 {
-    SymInfo *s = symtable_find(ctx->current_scope, name);
+    SymInfo *s = scope_find(&ctx->scopes, name);
+    if (!s)
+        s = symtable_find(ctx->global_scope, name);
     if (s && s->kind == SYM_VAR)
         return s;
     return NULL;
@@ -190,9 +174,17 @@ static bool sem_visit(SemContext *ctx, ASTNode *node)
     if (!node) return true;
 
     switch (node->type) {
-        case AST_PROGRAM:
         case AST_PROLOG:
+            return true;
+
         case AST_CLASS:
+            // children[0] is the class name, not a variable reference
+            for (int i = 1; i < node->child_count; ++i)
+                if (!sem_visit(ctx, node->children[i]))
+                    return false;
+            return true;
+
+        case AST_PROGRAM:
         case AST_FUNCTION_S:
         case AST_STATEMENTS:
             for (int i = 0; i < node->child_count; ++i)
@@ -287,7 +279,7 @@ static bool sem_normal_function(SemContext *ctx,
 
     int arity = params ? params->child_count : 0;
 
-    char *key = make_func_key(name, arity);
+    const char *key = make_func_key(name, arity);
     if (!key) error_exit(99, "Out of memory (func key)\n");
 
     SymInfo *existing = symtable_find(ctx->global_scope, key);
@@ -330,7 +322,6 @@ static bool sem_normal_function(SemContext *ctx,
     if (strcmp(name, "main") == 0 && arity == 0 && existing->info.func.defined)
         ctx->has_main_noargs = true;
 
-    free(key);
 
     // function body scope (params + body)
     sem_enter_scope(ctx);
@@ -341,7 +332,7 @@ static bool sem_normal_function(SemContext *ctx,
             ASTNode *p = params->children[i];
             const char *pname = p->token->lexeme;
 
-            if (symtable_find_local(ctx->current_scope, pname)) {
+            if (scope_find_local(&ctx->scopes, pname)) {
                 error_exit(4,
                            "Semantic error: duplicate parameter '%s' in function '%s'\n",
                            pname, name);
@@ -354,7 +345,7 @@ static bool sem_normal_function(SemContext *ctx,
             psym->info.var.is_global = false;
             psym->info.var.type_mask = TYPEMASK_ALL;
 
-            if (!symtable_insert(ctx->current_scope, pname, psym))
+            if (!scope_declare(&ctx->scopes, pname, psym))
                 error_exit(99, "symtable_insert(param) failed\n");
         }
     }
@@ -380,7 +371,7 @@ static bool sem_getter_body(SemContext *ctx,
     if (getter_node->child_count != 1)
         error_exit(99, "Internal: bad GETTER node\n");
 
-    char *gkey = make_getter_key(name);
+    const char *gkey = make_getter_key(name);
     if (!gkey) error_exit(99, "Out of memory (getter key)\n");
 
     SymInfo *sym = symtable_find(ctx->global_scope, gkey);
@@ -399,7 +390,6 @@ static bool sem_getter_body(SemContext *ctx,
         if (!symtable_insert(ctx->global_scope, gkey, sym))
             error_exit(99, "symtable_insert(getter) failed\n");
     }
-    free(gkey);
 
     ASTNode *body = getter_node->children[0];
 
@@ -427,7 +417,7 @@ static bool sem_setter_body(SemContext *ctx,
 
     const char *pname = param_node->token->lexeme;
 
-    char *skey = make_setter_key(name);
+    const char *skey = make_setter_key(name);
     if (!skey) error_exit(99, "Out of memory (setter key)\n");
 
     SymInfo *sym = symtable_find(ctx->global_scope, skey);
@@ -446,7 +436,6 @@ static bool sem_setter_body(SemContext *ctx,
         if (!symtable_insert(ctx->global_scope, skey, sym))
             error_exit(99, "symtable_insert(setter) failed\n");
     }
-    free(skey);
 
     sem_enter_scope(ctx);
 
@@ -457,7 +446,7 @@ static bool sem_setter_body(SemContext *ctx,
     psym->info.var.is_global = false;
     psym->info.var.type_mask = TYPEMASK_ALL;
 
-    if (!symtable_insert(ctx->current_scope, pname, psym))
+    if (!scope_declare(&ctx->scopes, pname, psym))
         error_exit(4, "Semantic error: duplicate parameter '%s' in setter '%s'\n",
                    pname, name);
 
@@ -496,7 +485,7 @@ static bool sem_var_decl(SemContext *ctx, ASTNode *node)
     const char *name = node->token->lexeme;
 
     // disallow duplicate in same scope
-    if (symtable_find_local(ctx->current_scope, name)) {
+    if (scope_find_local(&ctx->scopes, name)) {
         error_exit(4,
                    "Semantic error: duplicate variable '%s' in same scope\n",
                    name);
@@ -506,10 +495,10 @@ static bool sem_var_decl(SemContext *ctx, ASTNode *node)
     if (!sym) error_exit(99, "Out of memory (var SymInfo)\n");
 
     sym->kind = SYM_VAR;
-    sym->info.var.is_global = (ctx->current_scope == ctx->global_scope);
+    sym->info.var.is_global = (ctx->scopes.depth == 0);
     sym->info.var.type_mask = TYPEMASK_ALL;
 
-    if (!symtable_insert(ctx->current_scope, name, sym))
+    if (!scope_declare(&ctx->scopes, name, sym))
         error_exit(99, "symtable_insert(var) failed\n");
 
     // optional initializer: child[0] = AST_ASSIGN with child[0] = expr
@@ -563,11 +552,10 @@ static bool sem_assign(SemContext *ctx, ASTNode *node)
     }
 
     // try setter
-    char *skey = make_setter_key(name);
+    const char *skey = make_setter_key(name);
     if (!skey) error_exit(99, "Out of memory (setter key in assign)\n");
 
     SymInfo *setter = symtable_find(ctx->global_scope, skey);
-    free(skey);
 
     if (setter && setter->kind == SYM_FUNC) {
         // semantically as setter(name, expr); just check expr
@@ -593,7 +581,6 @@ static bool sem_assign(SemContext *ctx, ASTNode *node)
 static bool sem_call(SemContext *ctx, ASTNode *node)
 {
     const char *name = NULL;
-    bool        name_allocated = false;
     int         argc = 0;
     int         first_arg_index = 0;
 
@@ -605,11 +592,9 @@ static bool sem_call(SemContext *ctx, ASTNode *node)
     } else if (node->child_count > 0 &&
                node->children[0]->type == AST_FUNC_NAME) {
         // Builtin-style or Ifj.xxx: first child is FUNC_NAME, rest are args
-        char *full = builtin_extract_name(node->children[0]);
-        if (!full)
+        name = builtin_extract_name(node->children[0]);
+        if (!name)
             error_exit(99, "Internal: bad builtin FUNC_NAME\n");
-        name = full;
-        name_allocated = true;
         argc = node->child_count - 1;
         first_arg_index = 1;
     } else {
@@ -618,37 +603,34 @@ static bool sem_call(SemContext *ctx, ASTNode *node)
 
     // check all argument expressions
     for (int i = first_arg_index; i < node->child_count; ++i) {
-        if (!sem_visit(ctx, node->children[i])) {
-            if (name_allocated) free((char *)name);
+        if (!sem_visit(ctx, node->children[i]))
             return false;
-        }
     }
 
     // try builtin
     const BuiltinInfo *b = builtin_lookup(name, argc);
     if (b) {
         // you could set node->type_mask = b->ret_type here if you want
-        if (name_allocated) free((char *)name);
         return true;
     }
+    if (first_arg_index == 1) {
+        if (builtin_exists(name))
+            error_exit(5, "Semantic error: wrong number of arguments for '%s'\n", name);
+        error_exit(3, "Semantic error: undefined builtin '%s'\n", name);
+    }
 
     // normal static function in Program class
-    char *key = make_func_key(name, argc);
-    if (!key) {
-        if (name_allocated) free((char *)name);
+    const char *key = make_func_key(name, argc);
+    if (!key)
         error_exit(99, "Out of memory (func key in call)\n");
-    }
 
     SymInfo *f = symtable_find(ctx->global_scope, key);
 
     if (!f) {
         // create lazy forward declaration
         f = calloc(1, sizeof(SymInfo));
-        if (!f) {
-            free(key);
-            if (name_allocated) free((char *)name);
+        if (!f)
             error_exit(99, "Out of memory (lazy func)\n");
-        }
 
         f->kind = SYM_FUNC;
         f->info.func.arity           = argc;
@@ -659,23 +641,16 @@ static bool sem_call(SemContext *ctx, ASTNode *node)
         f->info.func.is_getter       = false;
         f->info.func.is_setter       = false;
 
-        if (!symtable_insert(ctx->global_scope, key, f)) {
-            free(key);
-            if (name_allocated) free((char *)name);
+        if (!symtable_insert(ctx->global_scope, key, f))
             error_exit(99, "symtable_insert(lazy func) failed\n");
-        }
 
         sem_register_func_record(ctx, f);
     } else if (f->kind != SYM_FUNC) {
-        free(key);
-        if (name_allocated) free((char *)name);
         error_exit(3,
                    "Semantic error: '%s' is not a function\n",
                    name);
     }
 
-    free(key);
-    if (name_allocated) free((char *)name);
     return true;
 }
 
@@ -743,6 +718,25 @@ static bool sem_return(SemContext *ctx, ASTNode *node)
 
 static bool sem_expr(SemContext *ctx, ASTNode *node)
 {
+    // calls can appear anywhere inside an expression
+    if (node->type == AST_CALL)
+        return sem_call(ctx, node);
+
+    // operator built by the PSA: token is the operator, children the operands
+    if (node->type == AST_EXPR && node->token && node->child_count == 2) {
+        for (int i = 0; i < node->child_count; ++i)
+            if (!sem_expr(ctx, node->children[i]))
+                return false;
+
+        if (node->token->type == TOK_KEYWORD && node->token->keyword == KW_IS) {
+            Token *rt = node->children[1]->token;
+            if (!rt || rt->type != TOK_KEYWORD ||
+                (rt->keyword != KW_Num && rt->keyword != KW_String && rt->keyword != KW_Null))
+                error_exit(2, "Syntax error: 'is' expects Num, String or Null\n");
+        }
+        return true;
+    }
+
     // If expr is just a wrapper, dive into child
     if (node->type == AST_EXPR && node->child_count == 1 && !node->token) {
         return sem_expr(ctx, node->children[0]);
@@ -767,9 +761,12 @@ static bool sem_expr(SemContext *ctx, ASTNode *node)
             if (sem_lookup_var(ctx, name))
                 return true;
 
-            // global variable (non-GID) not declared -> allowed, implicit null
-            // we don't insert symbol here; codegen can treat unknown as null.
-            return true;
+            // getter call without parentheses
+            if (symtable_find(ctx->global_scope, make_getter_key(name)))
+                return true;
+
+            error_exit(3, "Semantic error: undefined variable '%s'\n", name);
+            return false;
         }
 
         case TOK_GID: {
@@ -793,6 +790,7 @@ static bool sem_expr(SemContext *ctx, ASTNode *node)
         case TOK_FLOAT:
         case TOK_HEX:
         case TOK_STRING:
+        case TOK_BOOL:
             // literals always ok; you can set node->type_mask here if you want
             return true;
 
@@ -12,7 +12,7 @@ typedef struct FuncRecord {
 
 typedef struct {
     SymTable *global_scope;
-    SymTable *current_scope;
+    ScopeStack scopes;            // function-local block scopes
 
     bool has_main_noargs;
     FuncRecord *func_list;        // list of all user functions (for final check)
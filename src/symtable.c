@@ -1,94 +1,52 @@
 #include "symtable.h"
+#include "intern.h"
+#include "err.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#define SYMTABLE_INITIAL_CAP 8     // power of two, block scopes are small
+
 /* ---------------------------------------------------------
    Internal Helpers
    --------------------------------------------------------- */
-static char *cstrdup(const char *s)
-{
-    if (!s)
-        return NULL;
-    size_t len = strlen(s) + 1;
-    char *p = malloc(len);
-    if (p)
-        memcpy(p, s, len);
-    return p;
-}
-
-static SymNode *node_create(const char *key, SymInfo *sym) {
-    SymNode *node = malloc(sizeof(SymNode));
-    if (!node) return NULL;
-
-    node->key = cstrdup(key);
-    if (!node->key) {
-        free(node);
-        return NULL;
-    }
-
-    node->sym = sym;   // ownership transferred
-    node->left = node->right = NULL;
-    return node;
-}
-
-static void node_free(SymNode *node) {
-    if (!node) return;
+static void sym_free(SymInfo *sym) {
+    if (!sym) return;
 
     // Free symbol-specific heap data
-    if (node->sym) {
-        if (node->sym->kind == SYM_FUNC) {
-            // free array of param type_masks
-            if (node->sym->info.func.param_type_mask)
-                free(node->sym->info.func.param_type_mask);
-        }
-        free(node->sym);
+    if (sym->kind == SYM_FUNC) {
+        // free array of param type_masks
+        if (sym->info.func.param_type_mask)
+            free(sym->info.func.param_type_mask);
     }
-
-    free(node->key);
-    free(node);
+    free(sym);
 }
 
-static void bst_free(SymNode *root) {
-    if (!root) return;
-    bst_free(root->left);
-    bst_free(root->right);
-    node_free(root);
+/* Slot holding `key`, or the empty slot where it would go.
+   Keys are interned, so equal keys are equal pointers. */
+static SymEntry *slot_for(const SymTable *t, const char *key, uint32_t hash) {
+    uint32_t mask = t->cap - 1;
+    uint32_t i = hash & mask;
+
+    while (t->slots[i].key && t->slots[i].key != key)
+        i = (i + 1) & mask;
+    return &t->slots[i];
 }
 
-/* Recursive insert (not scoped logic, only current table) */
-static SymNode *bst_insert(SymNode *root, const char *key, SymInfo *sym, bool *inserted) {
-    if (!root) {
-        *inserted = true;
-        return node_create(key, sym);
-    }
+static bool table_grow(SymTable *t) {
+    uint32_t new_cap = t->cap ? t->cap * 2 : SYMTABLE_INITIAL_CAP;
+    SymEntry *new_slots = calloc(new_cap, sizeof(SymEntry));
+    if (!new_slots) return false;
 
-    int cmp = strcmp(key, root->key);
-
-    if (cmp == 0) {
-        *inserted = false;
-        return root;  // key already exists
-    } 
-    else if (cmp < 0) {
-        root->left = bst_insert(root->left, key, sym, inserted);
-    } 
-    else {
-        root->right = bst_insert(root->right, key, sym, inserted);
+    SymTable grown = { new_slots, new_cap, t->count, t->next };
+    for (uint32_t i = 0; i < t->cap; i++) {
+        if (t->slots[i].key)
+            *slot_for(&grown, t->slots[i].key, t->slots[i].hash) = t->slots[i];
     }
 
-    return root;
-}
-
-SymInfo *bst_find(SymNode *root, const char *key) {
-    if (!root) return NULL;
-    int cmp = strcmp(key, root->key);
-
-    if (cmp == 0)
-        return root->sym;
-    else if (cmp < 0)
-        return bst_find(root->left, key);
-    else
-        return bst_find(root->right, key);
+    free(t->slots);
+    *t = grown;
+    return true;
 }
 
 
@@ -100,10 +58,12 @@ SymTable *symtable_create(SymTable *parent) {
     SymTable *t = malloc(sizeof(SymTable));
     if (!t) return NULL;
 
-    t->root = NULL;
+    // slots are allocated on first insert, many block scopes stay empty
+    t->slots = NULL;
+    t->cap = 0;
+    t->count = 0;
 
     t->next = parent;  // parent scope
-    t->prev = NULL;    // unused (or remove from struct entirely)
 
     return t;
 }
@@ -111,60 +71,204 @@ SymTable *symtable_create(SymTable *parent) {
 
 void symtable_free(SymTable *table) {
     if (!table) return;
-    bst_free(table->root);
+    for (uint32_t i = 0; i < table->cap; i++) {
+        if (table->slots[i].key)
+            sym_free(table->slots[i].sym);
+    }
+    free(table->slots);
     free(table);
 }
 
 bool symtable_insert(SymTable *table, const char *key, SymInfo *sym) {
     if (!table || !key || !sym) return false;
 
-    bool inserted = false;
-    table->root = bst_insert(table->root, key, sym, &inserted);
-    return inserted;
+    // keep the load factor at or below 3/4
+    if ((table->count + 1) * 4 > table->cap * 3 && !table_grow(table))
+        return false;
+
+    uint32_t hash = intern_hash(key);
+    SymEntry *e = slot_for(table, key, hash);
+    if (e->key)
+        return false;  // key already exists
+
+    e->key = key;
+    e->hash = hash;
+    e->sym = sym;      // ownership transferred
+    table->count++;
+    return true;
+}
+
+SymInfo *symtable_find_local(SymTable *table, const char *key) {
+    if (!table || table->count == 0) return NULL;
+    SymEntry *e = slot_for(table, key, intern_hash(key));
+    return e->key ? e->sym : NULL;
 }
 
 /* Scoped lookup (current → parent → …) */
 SymInfo *symtable_find(SymTable *table, const char *key) {
     for (SymTable *t = table; t != NULL; t = t->next) {
-        SymInfo *s = bst_find(t->root, key);
+        SymInfo *s = symtable_find_local(t, key);
         if (s) return s;
     }
     return NULL;
 }
 
+/* ---------------------------------------------------------
+   Scope Stack
+   --------------------------------------------------------- */
+
+static ScopeSlot *scope_slot(const ScopeStack *s, const char *key, uint32_t hash) {
+    uint32_t mask = s->cap - 1;
+    uint32_t i = hash & mask;
+
+    while (s->slots[i].key && s->slots[i].key != key)
+        i = (i + 1) & mask;
+    return &s->slots[i];
+}
+
+static bool scope_grow_slots(ScopeStack *s) {
+    uint32_t new_cap = s->cap ? s->cap * 2 : SYMTABLE_INITIAL_CAP * 4;
+    ScopeSlot *new_slots = calloc(new_cap, sizeof(ScopeSlot));
+    if (!new_slots) return false;
+
+    ScopeStack grown = *s;
+    grown.slots = new_slots;
+    grown.cap = new_cap;
+    for (uint32_t i = 0; i < s->cap; i++) {
+        if (s->slots[i].key)
+            *scope_slot(&grown, s->slots[i].key, s->slots[i].hash) = s->slots[i];
+    }
+
+    free(s->slots);
+    s->slots = new_slots;
+    s->cap = new_cap;
+    return true;
+}
+
+void scope_init(ScopeStack *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void scope_free(ScopeStack *s) {
+    while (s->depth > 0)
+        scope_leave(s);
+    free(s->slots);
+    free(s->log);
+    free(s->marks);
+    scope_init(s);
+}
+
+void scope_enter(ScopeStack *s) {
+    if (s->depth == s->marks_cap) {
+        int cap = s->marks_cap ? 2 * s->marks_cap : 16;
+        int *marks = realloc(s->marks, sizeof(int) * cap);
+        if (!marks)
+            error_exit(99, "Out of memory (scope)\n");
+        s->marks = marks;
+        s->marks_cap = cap;
+    }
+    s->marks[s->depth++] = s->log_len;
+}
+
+void scope_leave(ScopeStack *s) {
+    if (s->depth == 0) return;
+
+    int mark = s->marks[--s->depth];
+    while (s->log_len > mark) {
+        ScopeBinding *b = &s->log[--s->log_len];
+        // the name is still in the table, so this probe always hits
+        scope_slot(s, b->key, intern_hash(b->key))->top = b->shadowed;
+        sym_free(b->sym);
+    }
+}
+
+bool scope_declare(ScopeStack *s, const char *key, SymInfo *sym) {
+    if (!key || !sym || s->depth == 0) return false;
+
+    if ((s->count + 1) * 4 > s->cap * 3 && !scope_grow_slots(s))
+        error_exit(99, "Out of memory (scope)\n");
+
+    uint32_t hash = intern_hash(key);
+    ScopeSlot *slot = scope_slot(s, key, hash);
+    if (!slot->key) {
+        slot->key = key;
+        slot->hash = hash;
+        slot->top = -1;
+        s->count++;
+    } else if (slot->top >= 0 && s->log[slot->top].depth == s->depth) {
+        return false;
+    }
+
+    if (s->log_len == s->log_cap) {
+        int cap = s->log_cap ? 2 * s->log_cap : 64;
+        ScopeBinding *log = realloc(s->log, sizeof(ScopeBinding) * cap);
+        if (!log)
+            error_exit(99, "Out of memory (scope)\n");
+        s->log = log;
+        s->log_cap = cap;
+    }
+
+    s->log[s->log_len] = (ScopeBinding){ key, sym, s->depth, slot->top };
+    slot->top = s->log_len++;
+    return true;
+}
+
+SymInfo *scope_find(const ScopeStack *s, const char *key) {
+    if (s->count == 0) return NULL;
+    ScopeSlot *slot = scope_slot(s, key, intern_hash(key));
+    return slot->key && slot->top >= 0 ? s->log[slot->top].sym : NULL;
+}
+
+SymInfo *scope_find_local(const ScopeStack *s, const char *key) {
+    if (s->count == 0) return NULL;
+    ScopeSlot *slot = scope_slot(s, key, intern_hash(key));
+    if (!slot->key || slot->top < 0 || s->log[slot->top].depth != s->depth)
+        return NULL;
+    return s->log[slot->top].sym;
+}
+
 /* ---------------------------------------------------------
    Function Overload Key Generator
    name + "$" + arity
    Example:   make_func_key("add", 2) → "add$2"
+   Keys are returned interned, callers must not free them.
    --------------------------------------------------------- */
-static char *make_key_suffix(const char *name, const char *suffix)
+static const char *make_key_suffix(const char *name, const char *suffix)
 {
     if (!name || !suffix) return NULL;
 
     size_t ln = strlen(name);
     size_t ls = strlen(suffix);
 
-    char *out = malloc(ln + ls + 1);
-    if (!out) return NULL;
+    char small[64];
+    char *buf = small;
+    if (ln + ls + 1 > sizeof(small)) {
+        buf = malloc(ln + ls + 1);
+        if (!buf) return NULL;
+    }
+
+    memcpy(buf, name, ln);
+    memcpy(buf + ln, suffix, ls + 1);
 
-    memcpy(out, name, ln);
-    memcpy(out + ln, suffix, ls + 1);
-    return out;
+    const char *key = intern(buf, ln + ls);
+    if (buf != small)
+        free(buf);
+    return key;
 }
 
-char *make_func_key(const char *name, int arity)
+const char *make_func_key(const char *name, int arity)
 {
     char buf[32];
     snprintf(buf, sizeof(buf), "$%d", arity);
     return make_key_suffix(name, buf);
 }
 
-char *make_getter_key(const char *name)
+const char *make_getter_key(const char *name)
 {
     return make_key_suffix(name, "$get");
 }
 
-char *make_setter_key(const char *name)
+const char *make_setter_key(const char *name)
 {
     return make_key_suffix(name, "$set");
 }
@@ -2,13 +2,16 @@
 #define SYMTABLE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
-#define TYPEMASK_NUM      0b0001
-#define TYPEMASK_STRING   0b0010
-#define TYPEMASK_NULL     0b0100
-#define TYPEMASK_BOOL     0b1000    // if BOOL type is added in the language
+#define TYPEMASK_INT      0b00001   // Num held as int@
+#define TYPEMASK_STRING   0b00010
+#define TYPEMASK_NULL     0b00100
+#define TYPEMASK_BOOL     0b01000   // if BOOL type is added in the language
+#define TYPEMASK_FLOAT    0b10000   // Num held as float@
 
-#define TYPEMASK_ALL      0b1111
+#define TYPEMASK_NUM      (TYPEMASK_INT | TYPEMASK_FLOAT)
+#define TYPEMASK_ALL      0b11111
 
 typedef unsigned char TypeMask;
 
@@ -21,6 +24,7 @@ typedef enum {
 typedef struct VarInfo {
     bool is_global;
     TypeMask type_mask;   // bitmask: T_NUM | T_STRING | T_NULL
+    int slot;             // IR lowering: index into IRFunc.vars
 } VarInfo;
 
 typedef struct FuncInfo {
@@ -43,34 +47,75 @@ typedef struct SymInfo {
     } info;
 } SymInfo;
 
-typedef struct SymNode {
-    char *key;
+typedef struct SymEntry {
+    const char *key;        // interned, NULL = empty slot
+    uint32_t hash;          // intern_hash(key), cached for probing/resizing
     SymInfo *sym;
-    struct SymNode *left;
-    struct SymNode *right;
-} SymNode;
+} SymEntry;
 
+// open addressing with linear probing, capacity is 0 or a power of two
 typedef struct SymTable {
-    SymNode *root;
-    struct SymTable *next;  
-    struct SymTable *prev;
+    SymEntry *slots;
+    uint32_t cap;
+    uint32_t count;
+    struct SymTable *next;  // parent scope
 } SymTable;
 
+/* Block scopes: one hash table for all nesting levels. Each name
+   keeps a shadow stack of bindings threaded through `log`, which
+   doubles as the undo log; marks[d] is the log length when scope
+   d+1 was entered. Enter/leave allocate nothing once warmed up. */
+typedef struct ScopeBinding {
+    const char *key;
+    SymInfo *sym;           // owned, freed when the scope is left
+    int depth;
+    int32_t shadowed;       // previous binding of key in log, -1 if none
+} ScopeBinding;
+
+typedef struct ScopeSlot {
+    const char *key;        // interned, NULL = empty slot
+    uint32_t hash;
+    int32_t top;            // innermost binding in log, -1 if none
+} ScopeSlot;
+
+typedef struct ScopeStack {
+    ScopeSlot *slots;
+    uint32_t cap;
+    uint32_t count;
+
+    ScopeBinding *log;
+    int log_len;
+    int log_cap;
+
+    int *marks;
+    int depth;
+    int marks_cap;
+} ScopeStack;
+
 /* -------------------- API -------------------- */
 
 // create / destroy
 SymTable *symtable_create(SymTable *parent);
 void symtable_free(SymTable *table);
 
-// insert & lookup
-SymInfo *bst_find(SymNode *root, const char *key);
+// insert & lookup (keys must be interned, see intern.h)
 bool symtable_insert(SymTable *table, const char *key, SymInfo *sym);
-SymInfo *symtable_find(SymTable *table, const char *key);
-
-// key generator for overload
-char *make_func_key(const char *name, int arity);
-
-char *make_setter_key(const char *name);
-char *make_getter_key(const char *name);
+SymInfo *symtable_find(SymTable *table, const char *key);        // walks parent scopes
+SymInfo *symtable_find_local(SymTable *table, const char *key);  // this scope only
+
+// scoped symbols (keys must be interned)
+void scope_init(ScopeStack *s);
+void scope_free(ScopeStack *s);
+void scope_enter(ScopeStack *s);
+void scope_leave(ScopeStack *s);
+bool scope_declare(ScopeStack *s, const char *key, SymInfo *sym);  // false if already in innermost scope
+SymInfo *scope_find(const ScopeStack *s, const char *key);          // innermost visible binding
+SymInfo *scope_find_local(const ScopeStack *s, const char *key);    // innermost scope only
+
+// key generator for overload (returns interned keys, do not free)
+const char *make_func_key(const char *name, int arity);
+
+const char *make_setter_key(const char *name);
+const char *make_getter_key(const char *name);
 
 #endif
\ No newline at end of file
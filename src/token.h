@@ -2,6 +2,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stddef.h>
+
 typedef enum {
     // identifiers & literals
     TOK_IDENTIFIER,
@@ -11,6 +13,7 @@ typedef enum {
     TOK_FLOAT,
     TOK_HEX,
     TOK_STRING,
+    TOK_BOOL,   // only made by constant folding, lexeme "true" / "false"
 
     // operators
     TOK_PLUS,   // +
@@ -43,10 +46,37 @@ typedef enum {
     TOK_ERROR
 } TokenType;
 
+// keywords are resolved by the scanner, TOK_KEYWORD tokens carry one of these
+typedef enum {
+    KW_NONE = 0,
+    KW_CLASS,
+    KW_IF,
+    KW_ELSE,
+    KW_IS,
+    KW_NULL,
+    KW_RETURN,
+    KW_VAR,
+    KW_WHILE,
+    KW_STATIC,
+    KW_IMPORT,
+    KW_FOR,
+    KW_Num,
+    KW_String,
+    KW_Null,
+    KW_Ifj
+} KeywordKind;
+
+// lexeme is interned for identifiers, keywords and numbers (valid until
+// intern_free()); a string literal's decoded text lives in the scanner's
+// lexeme pool (valid until scanner_free()). offset/length locate the raw
+// token text in the source
 typedef struct
 {
     TokenType type;
+    KeywordKind keyword;
     char *lexeme;
+    size_t offset;
+    size_t length;
 } Token;
 
 #endif
\ No newline at end of file
@@ -1,55 +1,528 @@
 #include "type_analysis.h"
+#include "builtin.h"
+#include "token.h"
+#include "err.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 
-static TypeMask infer_expr(TypeContext *ctx, ASTNode *expr);
+// Masks only ever grow: locals through branch merges and loop
+// iterations, function parameters / returns and globals across
+// passes over the whole program. The last pass runs with the fixed
+// point, so the masks it leaves on the nodes are the final ones.
+//
+// The passes walk the flat encoding of the tree (ast_flat.h) and
+// write node masks into its arrays; they are copied back onto the
+// ASTNodes once at the end.
+
+static TypeMask infer_expr(TypeContext *ctx, TypeEnv *env, FlatId expr);
+static void     infer_block(TypeContext *ctx, TypeEnv *env, FlatId block);
 static TypeMask merge_mask(TypeMask a, TypeMask b);
-static bool is_int_mask(TypeMask m);
+static bool     is_single_mask(TypeMask m);
 
 // ---------------------------
-// Entry
+// Environments
 // ---------------------------
-bool type_analyze(ASTNode *root, SymTable *global) {
-    TypeContext ctx = {
-        .global_scope = global,
-        .current_scope = global
-    };
 
-    // Traverse AST and infer types
-    // Only expressions and call sites matter; declarations do not
-    // You can choose either one big traversal or per-node recursion
+static void env_set(TypeEnv *env, int id, TypeMask m)
+{
+    if (id >= env->cap) {
+        int cap = env->cap ? env->cap * 2 : 16;
+        while (cap <= id)
+            cap *= 2;
+        TypeMask *p = realloc(env->mask, (size_t)cap);
+        if (!p)
+            error_exit(99, "Out of memory (type environment)\n");
+        memset(p + env->cap, 0, (size_t)(cap - env->cap));
+        env->mask = p;
+        env->cap = cap;
+    }
+    env->mask[id] = m;
+    if (id >= env->count)
+        env->count = id + 1;
+}
+
+static TypeEnv env_copy(const TypeEnv *src)
+{
+    TypeEnv e = { NULL, 0, 0, src->live };
+    for (int i = 0; i < src->count; i++)
+        env_set(&e, i, src->mask[i]);
+    return e;
+}
+
+static void env_free(TypeEnv *env)
+{
+    free(env->mask);
+    env->mask = NULL;
+    env->count = env->cap = 0;
+}
+
+// dst = dst ∪ src; a dead environment contributes nothing
+static void env_merge(TypeEnv *dst, const TypeEnv *src)
+{
+    if (!src->live)
+        return;
+    if (!dst->live) {
+        for (int i = 0; i < src->count; i++)
+            env_set(dst, i, src->mask[i]);
+        dst->live = true;
+        return;
+    }
+    for (int i = 0; i < src->count; i++)
+        env_set(dst, i, merge_mask(i < dst->count ? dst->mask[i] : 0, src->mask[i]));
+}
+
+static bool env_equal_prefix(const TypeEnv *a, const TypeEnv *b, int n)
+{
+    if (a->live != b->live)
+        return false;
+    for (int i = 0; i < n; i++) {
+        TypeMask x = i < a->count ? a->mask[i] : 0;
+        TypeMask y = i < b->count ? b->mask[i] : 0;
+        if (x != y)
+            return false;
+    }
+    return true;
+}
 
-    // Basic generic traversal:
-    switch (root->type) {
+// ---------------------------
+// Symbols
+// ---------------------------
+
+static void grow(TypeContext *ctx, TypeMask *slot, TypeMask m)
+{
+    TypeMask merged = merge_mask(*slot, m);
+    if (merged != *slot) {
+        *slot = merged;
+        ctx->changed = true;
+    }
+}
+
+static int declare_local(TypeContext *ctx, const char *name)
+{
+    SymInfo *sym = calloc(1, sizeof(SymInfo));
+    if (!sym)
+        error_exit(99, "Out of memory (type analysis local)\n");
+    sym->kind = SYM_VAR;
+    sym->info.var.slot = ctx->local_count++;
+
+    if (!scope_declare(&ctx->scopes, name, sym))
+        error_exit(99, "Internal: duplicate local '%s' in type analysis\n", name);
+    return sym->info.var.slot;
+}
+
+static SymInfo *global_var(TypeContext *ctx, const char *name)
+{
+    SymInfo *g = symtable_find_local(ctx->global_scope, name);
+    return (g && g->kind == SYM_VAR) ? g : NULL;
+}
+
+static SymInfo *user_func(TypeContext *ctx, const char *key)
+{
+    SymInfo *f = symtable_find_local(ctx->global_scope, key);
+    return (f && f->kind == SYM_FUNC && f->info.func.param_type_mask) ? f : NULL;
+}
+
+// ---------------------------
+// Expression type inference
+// ---------------------------
+
+static TypeMask literal_mask(const Token *tok)
+{
+    switch (tok->type) {
+        case TOK_INT:
+        case TOK_HEX:    return TYPEMASK_INT;
+        case TOK_FLOAT:  return TYPEMASK_FLOAT;
+        case TOK_STRING: return TYPEMASK_STRING;
+        case TOK_BOOL:   return TYPEMASK_BOOL;
+        case TOK_KEYWORD:
+            return tok->keyword == KW_NULL ? TYPEMASK_NULL : TYPEMASK_ALL;
+        default:         return TYPEMASK_ALL;
+    }
+}
+
+static TypeMask infer_ident(TypeContext *ctx, TypeEnv *env, const Token *tok)
+{
+    if (tok->type == TOK_KEYWORD)
+        return literal_mask(tok);
+
+    if (tok->type == TOK_IDENTIFIER) {
+        SymInfo *local = scope_find(&ctx->scopes, tok->lexeme);
+        if (local) {
+            int id = local->info.var.slot;
+            return id < env->count ? env->mask[id] : 0;
+        }
+    }
+
+    SymInfo *g = global_var(ctx, tok->lexeme);
+    if (g)
+        return g->info.var.type_mask;
+
+    // getter call without parentheses
+    SymInfo *getter = user_func(ctx, make_getter_key(tok->lexeme));
+    return getter ? getter->info.func.ret_type_mask : TYPEMASK_ALL;
+}
+
+// result of `a op b`; operand combinations that fail at run time add nothing.
+// int op int stays int, a float on either side makes the result a float.
+static TypeMask binary_result(const Token *op, TypeMask a, TypeMask b)
+{
+    bool nums = (a & TYPEMASK_NUM) && (b & TYPEMASK_NUM);
+    TypeMask num = ((a & b & TYPEMASK_INT) ? TYPEMASK_INT : 0) |
+                   ((nums && ((a | b) & TYPEMASK_FLOAT)) ? TYPEMASK_FLOAT : 0);
+
+    switch (op->type) {
+        case TOK_PLUS:
+            return num | (((a & b) & TYPEMASK_STRING) ? TYPEMASK_STRING : 0);
+        case TOK_STAR:
+            return num | (((a & TYPEMASK_STRING) && (b & TYPEMASK_NUM)) ? TYPEMASK_STRING : 0);
+        case TOK_MINUS:
+            return num;
+        case TOK_SLASH:
+            return nums ? TYPEMASK_FLOAT : 0;   // always a float division
         default:
-            for (int i = 0; i < root->child_count; i++) {
-                if (!type_analyze(root->children[i], global))
-                    return false;
+            return TYPEMASK_BOOL;   // relational, equality, is
+    }
+}
+
+static TypeMask infer_call(TypeContext *ctx, TypeEnv *env, FlatId call)
+{
+    const FlatAST *fa = ctx->fa;
+    const Token *tok = ast_flat_token(fa, call);
+
+    if (!tok) {
+        // Ifj.name(args), child 0 is the AST_FUNC_NAME
+        FlatId fname = fa->first_child[call];
+        int argc = 0;
+        for (FlatId a = fa->next_sibling[fname]; a != FLAT_NONE; a = fa->next_sibling[a]) {
+            infer_expr(ctx, env, a);
+            argc++;
+        }
+
+        const Token *ns = ast_flat_token(fa, ast_flat_child(fa, fname, 0));
+        const Token *id = ast_flat_token(fa, ast_flat_child(fa, fname, 1));
+        const BuiltinInfo *b = ns && id ? builtin_lookup(builtin_join_name(ns->lexeme, id->lexeme), argc)
+                                        : NULL;
+        return b && b->ret_type ? b->ret_type : TYPEMASK_ALL;
+    }
+
+    int argc = ast_flat_child_count(fa, call);
+    SymInfo *f = user_func(ctx, make_func_key(tok->lexeme, argc));
+
+    int i = 0;
+    FLAT_FOR_EACH_CHILD(fa, call, a) {
+        TypeMask m = infer_expr(ctx, env, a);
+        if (f)
+            grow(ctx, &f->info.func.param_type_mask[i], m);
+        i++;
+    }
+    return f ? f->info.func.ret_type_mask : TYPEMASK_ALL;
+}
+
+static TypeMask infer_expr(TypeContext *ctx, TypeEnv *env, FlatId expr)
+{
+    FlatAST *fa = ctx->fa;
+    const Token *tok = ast_flat_token(fa, expr);
+    TypeMask m = TYPEMASK_ALL;
+    bool dynamic = false;
+
+    switch (fa->kind[expr]) {
+        case AST_LITERAL:
+            m = literal_mask(tok);
+            break;
+
+        case AST_CALL:
+            m = infer_call(ctx, env, expr);
+            break;
+
+        case AST_GID:
+        case AST_IDENTIFIER:
+            m = infer_ident(ctx, env, tok);
+            break;
+
+        case AST_EXPR: {
+            int n = ast_flat_child_count(fa, expr);
+            FlatId lhs = fa->first_child[expr];
+            if (!tok && n == 1) {
+                m = infer_expr(ctx, env, lhs);
+            } else if (tok && n == 2) {
+                TypeMask a = infer_expr(ctx, env, lhs);
+                bool is_op = tok->type == TOK_KEYWORD;
+                TypeMask b = is_op ? TYPEMASK_ALL
+                                   : infer_expr(ctx, env, fa->next_sibling[lhs]);
+                m = binary_result(tok, a, b);
+                dynamic = !is_single_mask(a) || (!is_op && !is_single_mask(b));
+            } else if (tok) {
+                m = literal_mask(tok);
             }
             break;
+        }
+
+        default:
+            break;
     }
 
-    return true;
+    fa->type_mask[expr] = m;
+    fa->dyn_check[expr] = dynamic;
+    return m;
 }
 
 // ---------------------------
-// Expression type inference
+// Statements
 // ---------------------------
-static TypeMask infer_expr(TypeContext *ctx, ASTNode *expr) {
 
-    // TODO:
-    // 1. If literal → return NUM, STRING, or NULL mask
-    // 2. If identifier → get VarInfo.type_mask or getter return type
-    // 3. If binary operator:
-    //      - infer children recursively
-    //      - check operator rules (static error 6 if impossible)
-    // 4. If function call:
-    //      - lookup function symbol
-    //      - merge param_type_mask with given arguments
-    //      - return function.ret_type_mask
-    // 5. If runtime unknown types → return TYPEMASK_ALL
+static void infer_var_decl(TypeContext *ctx, TypeEnv *env, FlatId node)
+{
+    const FlatAST *fa = ctx->fa;
+
+    // initializer is evaluated before the name comes into scope
+    TypeMask m = TYPEMASK_NULL;
+    if (fa->first_child[node] != FLAT_NONE)
+        m = infer_expr(ctx, env, fa->first_child[fa->first_child[node]]);
+
+    env_set(env, declare_local(ctx, ast_flat_token(fa, node)->lexeme), m);
+}
+
+static void infer_assign(TypeContext *ctx, TypeEnv *env, FlatId node)
+{
+    const Token *target = ast_flat_token(ctx->fa, node);
+    TypeMask m = infer_expr(ctx, env, ctx->fa->first_child[node]);
 
-    return TYPEMASK_ALL;
+    if (target->type == TOK_IDENTIFIER) {
+        SymInfo *local = scope_find(&ctx->scopes, target->lexeme);
+        if (local) {
+            env_set(env, local->info.var.slot, m);
+            return;
+        }
+    }
+
+    // globals are tracked flow-insensitively, they start out as null
+    SymInfo *g = global_var(ctx, target->lexeme);
+    if (g) {
+        grow(ctx, &g->info.var.type_mask, m);
+        return;
+    }
+
+    SymInfo *setter = user_func(ctx, make_setter_key(target->lexeme));
+    if (setter)
+        grow(ctx, &setter->info.func.param_type_mask[0], m);
+}
+
+static void infer_return(TypeContext *ctx, TypeEnv *env, FlatId node)
+{
+    TypeMask m = TYPEMASK_NULL;
+    if (ctx->fa->first_child[node] != FLAT_NONE)
+        m = infer_expr(ctx, env, ctx->fa->first_child[node]);
+
+    if (env->live)
+        grow(ctx, &ctx->func->info.func.ret_type_mask, m);
+    env->live = false;
+}
+
+static void infer_if(TypeContext *ctx, TypeEnv *env, FlatId ifnode, FlatId elsenode)
+{
+    const FlatAST *fa = ctx->fa;
+    FlatId cond = fa->first_child[ifnode];
+
+    infer_expr(ctx, env, cond);
+
+    TypeEnv other = env_copy(env);
+    infer_block(ctx, env, fa->next_sibling[cond]);
+    if (elsenode != FLAT_NONE)
+        infer_block(ctx, &other, fa->first_child[elsenode]);
+
+    env_merge(env, &other);
+    env_free(&other);
+}
+
+static void infer_while(TypeContext *ctx, TypeEnv *env, FlatId node)
+{
+    FlatId cond = ctx->fa->first_child[node];
+    FlatId block = ctx->fa->next_sibling[cond];
+
+    // locals declared in the body get the same ids on every iteration
+    int outer = ctx->local_count;
+
+    while (1) {
+        ctx->local_count = outer;
+
+        TypeEnv body = env_copy(env);
+        infer_expr(ctx, &body, cond);
+        infer_block(ctx, &body, block);
+
+        TypeEnv next = env_copy(env);
+        env_merge(&next, &body);
+        env_free(&body);
+
+        bool stable = env_equal_prefix(&next, env, outer);
+        env_free(env);
+        *env = next;
+        if (stable)
+            break;
+    }
+
+    // the condition on the final state decides the exit
+    infer_expr(ctx, env, cond);
+}
+
+static void infer_statement(TypeContext *ctx, TypeEnv *env, FlatId node)
+{
+    switch (ctx->fa->kind[node]) {
+        case AST_VAR_DECL: infer_var_decl(ctx, env, node); break;
+        case AST_ASSIGN:   infer_assign(ctx, env, node); break;
+        case AST_RETURN:   infer_return(ctx, env, node); break;
+        case AST_WHILE:    infer_while(ctx, env, node); break;
+        case AST_BLOCK:    infer_block(ctx, env, node); break;
+        case AST_IF:       infer_if(ctx, env, node, FLAT_NONE); break;
+
+        case AST_CALL:
+        case AST_IDENTIFIER:
+        case AST_GID:
+            infer_expr(ctx, env, node);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void infer_block(TypeContext *ctx, TypeEnv *env, FlatId block)
+{
+    const FlatAST *fa = ctx->fa;
+
+    scope_enter(&ctx->scopes);
+
+    for (FlatId st = fa->first_child[block]; st != FLAT_NONE; st = fa->next_sibling[st]) {
+        FlatId next = fa->next_sibling[st];
+
+        // the parser places an IF and its ELSE next to each other
+        if (fa->kind[st] == AST_IF && next != FLAT_NONE && fa->kind[next] == AST_ELSE) {
+            infer_if(ctx, env, st, next);
+            st = next;
+            continue;
+        }
+        infer_statement(ctx, env, st);
+    }
+
+    scope_leave(&ctx->scopes);
+}
+
+// ---------------------------
+// Functions
+// ---------------------------
+
+// the parameters of a definition are `count` consecutive siblings from `first`
+static void infer_function(TypeContext *ctx, SymInfo *f, FlatId first, int count, FlatId body)
+{
+    TypeEnv env = { NULL, 0, 0, true };
+
+    ctx->func = f;
+    ctx->local_count = 0;
+    scope_enter(&ctx->scopes);
+
+    FlatId p = first;
+    for (int i = 0; i < count; i++, p = ctx->fa->next_sibling[p])
+        env_set(&env, declare_local(ctx, ast_flat_token(ctx->fa, p)->lexeme),
+                f->info.func.param_type_mask[i]);
+
+    infer_block(ctx, &env, body);
+
+    // falling off the end returns null
+    if (env.live)
+        grow(ctx, &f->info.func.ret_type_mask, TYPEMASK_NULL);
+
+    scope_leave(&ctx->scopes);
+    env_free(&env);
+}
+
+// calls fn(ctx, sym, first param, param count, body) for every function definition
+static void for_each_function(TypeContext *ctx,
+                              void (*fn)(TypeContext *, SymInfo *, FlatId, int, FlatId))
+{
+    const FlatAST *fa = ctx->fa;
+    FlatId cls = ast_flat_child(fa, 0, 1);
+
+    FLAT_FOR_EACH_IN_SUBTREE(fa, cls, def) {
+        if (fa->kind[def] != AST_FUNCTION_DEF)
+            continue;
+
+        FlatId name = fa->first_child[def];
+        FlatId kind = fa->next_sibling[name];
+        const char *id = ast_flat_token(fa, name)->lexeme;
+        const char *key;
+        FlatId first = FLAT_NONE, body;
+        int count = 0;
+
+        switch (fa->kind[kind]) {
+            case AST_FUNCTION: {
+                FlatId params = fa->first_child[kind];
+                first = fa->first_child[params];
+                count = ast_flat_child_count(fa, params);
+                key = make_func_key(id, count);
+                body = fa->next_sibling[params];
+                break;
+            }
+            case AST_GETTER:
+                key = make_getter_key(id);
+                body = fa->first_child[kind];
+                break;
+            case AST_SETTER:
+                first = fa->first_child[kind];
+                count = 1;
+                key = make_setter_key(id);
+                body = fa->next_sibling[first];
+                break;
+            default:
+                continue;
+        }
+
+        SymInfo *f = symtable_find_local(ctx->global_scope, key);
+        if (f && f->kind == SYM_FUNC)
+            fn(ctx, f, first, count, body);
+    }
+}
+
+static void reset_function(TypeContext *ctx, SymInfo *f, FlatId first, int count, FlatId body)
+{
+    (void)ctx;
+    (void)first;
+    (void)body;
+
+    free(f->info.func.param_type_mask);
+    f->info.func.param_type_mask = calloc((size_t)count + 1, sizeof(TypeMask));
+    if (!f->info.func.param_type_mask)
+        error_exit(99, "Out of memory (parameter masks)\n");
+    f->info.func.ret_type_mask = 0;
+}
+
+// ---------------------------
+// Entry
+// ---------------------------
+bool type_analyze(ASTNode *root, SymTable *global) {
+    TypeContext ctx = {
+        .global_scope = global,
+        .fa           = ast_flat_build(root)
+    };
+    scope_init(&ctx.scopes);
+
+    // start from nothing: globals are null until assigned
+    for (uint32_t i = 0; i < global->cap; i++) {
+        SymEntry *e = &global->slots[i];
+        if (e->key && e->sym->kind == SYM_VAR)
+            e->sym->info.var.type_mask = TYPEMASK_NULL;
+    }
+    for_each_function(&ctx, reset_function);
+
+    do {
+        ctx.changed = false;
+        for_each_function(&ctx, infer_function);
+    } while (ctx.changed);
+
+    ast_flat_store_types(ctx.fa, root);
+    ast_flat_free(ctx.fa);
+    scope_free(&ctx.scopes);
+    return true;
 }
 
 // ---------------------------
@@ -60,8 +533,7 @@ static TypeMask merge_mask(TypeMask a, TypeMask b) {
     return a | b;
 }
 
-static bool is_int_mask(TypeMask m) {
-    // For STATICAN: track Num vs. integer-Num
-    // Basic project → treat all Num as non-integer unless literal
-    return false;
+// exactly one runtime type, so the operator needs no dispatch on it
+static bool is_single_mask(TypeMask m) {
+    return m != 0 && (m & (m - 1)) == 0;
 }
@@ -2,15 +2,30 @@
 #define TYPE_ANALYSIS_H
 
 #include "ast.h"
+#include "ast_flat.h"
 #include "symtable.h"
 
+// local variable masks at one program point, indexed by local id
 typedef struct {
-    SymTable *global_scope;
-    SymTable *current_scope;
+    TypeMask *mask;
+    int count;
+    int cap;
+    bool live;          // false after a return
+} TypeEnv;
+
+typedef struct {
+    SymTable  *global_scope;
+    ScopeStack scopes;      // locals of the current function → slot = local id
+    int        local_count;
+    FlatAST   *fa;          // flat encoding of the tree being analysed
+    SymInfo   *func;        // function being analysed
+    bool       changed;     // some function or global mask grew this pass
 } TypeContext;
 
-/// Run full type inference + static type error detection.
-/// Returns true on success, false on type error.
+/// Flow-sensitive type inference over the analysed AST.
+/// Fills ASTNode.type_mask / needs_dynamic_check of expressions,
+/// FuncInfo.ret_type_mask / param_type_mask of user functions and
+/// VarInfo.type_mask of globals. Returns true on success.
 bool type_analyze(ASTNode *root, SymTable *global_symtable);
 
 #endif
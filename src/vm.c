@@ -0,0 +1,1272 @@
+// vm.c
+
+#include "vm.h"
+#include "err.h"
+#include "intern.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// labels as values (computed goto) where the compiler has them
+#if defined(__GNUC__) && !defined(VM_NO_THREADING)
+#define VM_THREADED 1
+#endif
+
+/* ---------------------------------------------------------
+   Values
+   Strings are immutable and reference counted, so MOVE and
+   PUSHS only copy a pointer; SETCHAR copies on write.
+   --------------------------------------------------------- */
+
+typedef enum {
+    V_UNDEF,        // no DEFVAR for this slot
+    V_UNINIT,       // defined, never assigned
+    V_NIL,
+    V_INT,
+    V_FLOAT,
+    V_BOOL,
+    V_STRING
+} ValueType;
+
+typedef struct {
+    int    refs;
+    size_t len;
+    char   data[];      // NUL-terminated
+} VMString;
+
+typedef struct {
+    ValueType type;
+    union {
+        long long i;
+        double    f;
+        bool      b;
+        VMString *s;
+    } u;
+} Value;
+
+static VMString *str_new(const char *s, size_t len)
+{
+    VMString *str = malloc(sizeof(VMString) + len + 1);
+    if (!str)
+        error_exit(99, "Out of memory (vm string)\n");
+    str->refs = 1;
+    str->len = len;
+    memcpy(str->data, s, len);
+    str->data[len] = '\0';
+    return str;
+}
+
+static void value_release(Value *v)
+{
+    if (v->type == V_STRING && --v->u.s->refs == 0)
+        free(v->u.s);
+}
+
+// *dst = *src, both stay valid
+static void value_copy(Value *dst, const Value *src)
+{
+    if (src->type == V_STRING)
+        src->u.s->refs++;
+    value_release(dst);
+    *dst = *src;
+}
+
+// *dst = v, `v` is consumed
+static void value_take(Value *dst, Value v)
+{
+    value_release(dst);
+    *dst = v;
+}
+
+static Value make_int(long long i)   { return (Value){ .type = V_INT, .u.i = i }; }
+static Value make_float(double f)    { return (Value){ .type = V_FLOAT, .u.f = f }; }
+static Value make_bool(bool b)       { return (Value){ .type = V_BOOL, .u.b = b }; }
+static Value make_nil(void)          { return (Value){ .type = V_NIL }; }
+
+static Value make_string(const char *s, size_t len)
+{
+    return (Value){ .type = V_STRING, .u.s = str_new(s, len) };
+}
+
+/* ---------------------------------------------------------
+   Instructions
+   --------------------------------------------------------- */
+
+typedef enum {
+    OP_MOVE, OP_CREATEFRAME, OP_PUSHFRAME, OP_POPFRAME, OP_DEFVAR,
+    OP_CALL, OP_RETURN,
+    OP_PUSHS, OP_POPS, OP_CLEARS,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_IDIV,
+    OP_ADDS, OP_SUBS, OP_MULS, OP_DIVS, OP_IDIVS,
+    OP_LT, OP_GT, OP_EQ, OP_LTS, OP_GTS, OP_EQS,
+    OP_AND, OP_OR, OP_NOT, OP_ANDS, OP_ORS, OP_NOTS,
+    OP_INT2FLOAT, OP_FLOAT2INT, OP_INT2CHAR, OP_STRI2INT,
+    OP_INT2FLOATS, OP_FLOAT2INTS, OP_INT2CHARS, OP_STRI2INTS,
+    OP_INT2STR, OP_FLOAT2STR, OP_ISINT,
+    OP_READ, OP_WRITE,
+    OP_CONCAT, OP_STRLEN, OP_GETCHAR, OP_SETCHAR,
+    OP_TYPE,
+    OP_LABEL, OP_JUMP, OP_JUMPIFEQ, OP_JUMPIFNEQ, OP_JUMPIFEQS, OP_JUMPIFNEQS,
+    OP_EXIT,
+    OP_BREAK, OP_DPRINT,
+    OP_END,             // past the last instruction
+    OP_COUNT
+} Opcode;
+
+// name and operands: v variable, s symbol, l label, t type
+static const struct {
+    const char *name;
+    const char *operands;
+} opcodes[OP_COUNT] = {
+    [OP_MOVE] = { "MOVE", "vs" },           [OP_CREATEFRAME] = { "CREATEFRAME", "" },
+    [OP_PUSHFRAME] = { "PUSHFRAME", "" },   [OP_POPFRAME] = { "POPFRAME", "" },
+    [OP_DEFVAR] = { "DEFVAR", "v" },        [OP_CALL] = { "CALL", "l" },
+    [OP_RETURN] = { "RETURN", "" },
+    [OP_PUSHS] = { "PUSHS", "s" },          [OP_POPS] = { "POPS", "v" },
+    [OP_CLEARS] = { "CLEARS", "" },
+    [OP_ADD] = { "ADD", "vss" },            [OP_SUB] = { "SUB", "vss" },
+    [OP_MUL] = { "MUL", "vss" },            [OP_DIV] = { "DIV", "vss" },
+    [OP_IDIV] = { "IDIV", "vss" },
+    [OP_ADDS] = { "ADDS", "" },             [OP_SUBS] = { "SUBS", "" },
+    [OP_MULS] = { "MULS", "" },             [OP_DIVS] = { "DIVS", "" },
+    [OP_IDIVS] = { "IDIVS", "" },
+    [OP_LT] = { "LT", "vss" },              [OP_GT] = { "GT", "vss" },
+    [OP_EQ] = { "EQ", "vss" },              [OP_LTS] = { "LTS", "" },
+    [OP_GTS] = { "GTS", "" },               [OP_EQS] = { "EQS", "" },
+    [OP_AND] = { "AND", "vss" },            [OP_OR] = { "OR", "vss" },
+    [OP_NOT] = { "NOT", "vs" },             [OP_ANDS] = { "ANDS", "" },
+    [OP_ORS] = { "ORS", "" },               [OP_NOTS] = { "NOTS", "" },
+    [OP_INT2FLOAT] = { "INT2FLOAT", "vs" }, [OP_FLOAT2INT] = { "FLOAT2INT", "vs" },
+    [OP_INT2CHAR] = { "INT2CHAR", "vs" },   [OP_STRI2INT] = { "STRI2INT", "vss" },
+    [OP_INT2FLOATS] = { "INT2FLOATS", "" }, [OP_FLOAT2INTS] = { "FLOAT2INTS", "" },
+    [OP_INT2CHARS] = { "INT2CHARS", "" },   [OP_STRI2INTS] = { "STRI2INTS", "" },
+    [OP_INT2STR] = { "INT2STR", "vs" },     [OP_FLOAT2STR] = { "FLOAT2STR", "vs" },
+    [OP_ISINT] = { "ISINT", "vs" },
+    [OP_READ] = { "READ", "vt" },           [OP_WRITE] = { "WRITE", "s" },
+    [OP_CONCAT] = { "CONCAT", "vss" },      [OP_STRLEN] = { "STRLEN", "vs" },
+    [OP_GETCHAR] = { "GETCHAR", "vss" },    [OP_SETCHAR] = { "SETCHAR", "vss" },
+    [OP_TYPE] = { "TYPE", "vs" },
+    [OP_LABEL] = { "LABEL", "l" },          [OP_JUMP] = { "JUMP", "l" },
+    [OP_JUMPIFEQ] = { "JUMPIFEQ", "lss" },  [OP_JUMPIFNEQ] = { "JUMPIFNEQ", "lss" },
+    [OP_JUMPIFEQS] = { "JUMPIFEQS", "l" },  [OP_JUMPIFNEQS] = { "JUMPIFNEQS", "l" },
+    [OP_EXIT] = { "EXIT", "s" },
+    [OP_BREAK] = { "BREAK", "" },           [OP_DPRINT] = { "DPRINT", "s" },
+    [OP_END] = { NULL, "" },
+};
+
+typedef enum {
+    A_NONE,
+    A_GF, A_LF, A_TF,   // index: slot in the frame
+    A_CONST,            // value
+    A_TYPE              // index: ValueType
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int         index;
+    Value       value;
+} Operand;
+
+typedef struct {
+    const void *handler;    // dispatch address (threaded builds)
+    Opcode      op;
+    int         line;       // in the IFJcode25 text, for error messages
+    int         target;     // jumps and CALL: instruction index, -1 unknown label
+    Operand     a, b, c;
+} Instr;
+
+/* ---------------------------------------------------------
+   Machine state
+   GF slots are numbered over all GF@ names, LF/TF slots over
+   all LF@/TF@ names (a PUSHFRAME'd TF becomes the LF). Frames
+   grow on DEFVAR and go back to a pool when dropped.
+   --------------------------------------------------------- */
+
+typedef struct {
+    Value *slots;
+    int    cap;
+} Frame;
+
+typedef struct {
+    int *ids;           // per intern_id: slot + 1, 0 when unseen
+    int  cap;
+    int  count;
+} NameMap;
+
+typedef struct {
+    Instr   *code;
+    int      count, cap;
+
+    NameMap  globals, locals, labels;
+    int     *label_at;      // per label: instruction index, -1 undefined
+    int      label_cap;
+
+    Frame    gf;
+    Frame   *tf;            // NULL: no temporary frame
+    Frame  **lf;            // frame stack, top is LF
+    int      lf_count, lf_cap;
+    Frame  **pool;
+    int      pool_count, pool_cap;
+
+    Value   *stack;
+    int      sp, stack_cap;
+    int     *calls;         // return addresses
+    int      call_count, call_cap;
+
+    char    *line;          // READ buffer
+    int      line_cap;
+} VM;
+
+static void *grow(void *p, int *cap, int need, size_t size)
+{
+    if (need <= *cap)
+        return p;
+    int n = *cap ? *cap : 16;
+    while (n < need)
+        n *= 2;
+    p = realloc(p, (size_t)n * size);
+    if (!p)
+        error_exit(99, "Out of memory (vm)\n");
+    *cap = n;
+    return p;
+}
+
+static int name_slot(NameMap *map, const char *s, size_t len)
+{
+    uint32_t id = intern_id(intern(s, len));
+    if ((int)id >= map->cap) {
+        int old = map->cap;
+        map->ids = grow(map->ids, &map->cap, (int)id + 1, sizeof(int));
+        memset(map->ids + old, 0, (size_t)(map->cap - old) * sizeof(int));
+    }
+    if (!map->ids[id])
+        map->ids[id] = ++map->count;
+    return map->ids[id] - 1;
+}
+
+static void frame_reserve(Frame *f, int slots)
+{
+    int old = f->cap;
+    f->slots = grow(f->slots, &f->cap, slots, sizeof(Value));
+    memset(f->slots + old, 0, (size_t)(f->cap - old) * sizeof(Value));
+}
+
+static Frame *frame_new(VM *vm)
+{
+    if (vm->pool_count > 0)
+        return vm->pool[--vm->pool_count];
+    Frame *f = calloc(1, sizeof(Frame));
+    if (!f)
+        error_exit(99, "Out of memory (vm frame)\n");
+    return f;
+}
+
+static void frame_clear(Frame *f)
+{
+    for (int i = 0; i < f->cap; i++)
+        value_release(&f->slots[i]);
+    memset(f->slots, 0, (size_t)f->cap * sizeof(Value));
+}
+
+static void frame_drop(VM *vm, Frame *f)
+{
+    if (!f)
+        return;
+    frame_clear(f);
+    vm->pool = grow(vm->pool, &vm->pool_cap, vm->pool_count + 1, sizeof(Frame *));
+    vm->pool[vm->pool_count++] = f;
+}
+
+/* ---------------------------------------------------------
+   Loading
+   --------------------------------------------------------- */
+
+#define VM_ERR_SYNTAX 51
+#define VM_ERR_SEM    52
+
+static int load_error(int line, const char *msg)
+{
+    fprintf(stderr, "%d: %s\nSyntax error!\n", line, msg);
+    return VM_ERR_SYNTAX;
+}
+
+static bool parse_string(const char *s, size_t len, Value *out)
+{
+    char *buf = malloc(len + 1);
+    if (!buf)
+        error_exit(99, "Out of memory (vm)\n");
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] != '\\') {
+            buf[n++] = s[i];
+            continue;
+        }
+        if (i + 3 >= len || !isdigit((unsigned char)s[i + 1]) ||
+            !isdigit((unsigned char)s[i + 2]) || !isdigit((unsigned char)s[i + 3])) {
+            free(buf);
+            return false;
+        }
+        int c = (s[i + 1] - '0') * 100 + (s[i + 2] - '0') * 10 + (s[i + 3] - '0');
+        if (c > 255) {
+            free(buf);
+            return false;
+        }
+        buf[n++] = (char)c;
+        i += 3;
+    }
+
+    *out = make_string(buf, n);
+    free(buf);
+    return true;
+}
+
+static bool parse_constant(const char *tok, size_t len, Value *out)
+{
+    const char *at = memchr(tok, '@', len);
+    if (!at)
+        return false;
+    size_t head = (size_t)(at - tok), rest = len - head - 1;
+    const char *v = at + 1;
+
+    char text[512];
+    bool fits = rest < sizeof(text);
+    if (fits) {
+        memcpy(text, v, rest);
+        text[rest] = '\0';
+    }
+
+    if (head == 6 && strncmp(tok, "string", 6) == 0)
+        return parse_string(v, rest, out);
+    if (!fits || rest == 0)
+        return false;
+
+    char *end;
+    if (head == 3 && strncmp(tok, "int", 3) == 0) {
+        errno = 0;
+        long long i = strtoll(text, &end, 10);
+        *out = make_int(i);
+        return *end == '\0' && errno == 0;
+    }
+    if (head == 5 && strncmp(tok, "float", 5) == 0) {
+        // hexadecimal only, as printed by %a
+        const char *hex = text[0] == '-' || text[0] == '+' ? text + 1 : text;
+        if (hex[0] != '0' || (hex[1] != 'x' && hex[1] != 'X'))
+            return false;
+        double f = strtod(text, &end);
+        *out = make_float(f);
+        return *end == '\0';
+    }
+    if (head == 4 && strncmp(tok, "bool", 4) == 0) {
+        *out = make_bool(strcmp(text, "true") == 0);
+        return strcmp(text, "true") == 0 || strcmp(text, "false") == 0;
+    }
+    if (head == 3 && strncmp(tok, "nil", 3) == 0) {
+        *out = make_nil();
+        return strcmp(text, "nil") == 0;
+    }
+    return false;
+}
+
+static bool parse_operand(VM *vm, char kind, const char *tok, size_t len, Operand *o)
+{
+    static const struct { const char *name; ValueType type; } types[] = {
+        { "int", V_INT }, { "float", V_FLOAT }, { "string", V_STRING },
+        { "bool", V_BOOL }, { "nil", V_NIL },
+    };
+
+    bool var = len > 3 && tok[2] == '@' &&
+               (strncmp(tok, "GF", 2) == 0 || strncmp(tok, "LF", 2) == 0 ||
+                strncmp(tok, "TF", 2) == 0);
+    if (var) {
+        if (kind != 'v' && kind != 's')
+            return false;
+        o->kind = tok[0] == 'G' ? A_GF : tok[0] == 'L' ? A_LF : A_TF;
+        o->index = name_slot(o->kind == A_GF ? &vm->globals : &vm->locals, tok + 3, len - 3);
+        return true;
+    }
+
+    switch (kind) {
+        case 's':
+            o->kind = A_CONST;
+            return parse_constant(tok, len, &o->value);
+        case 'l':
+            o->index = name_slot(&vm->labels, tok, len);
+            return true;
+        case 't':
+            for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+                if (strlen(types[i].name) == len && strncmp(types[i].name, tok, len) == 0) {
+                    o->kind = A_TYPE;
+                    o->index = types[i].type;
+                    return true;
+                }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static Opcode find_opcode(const char *tok, size_t len)
+{
+    for (int op = 0; op < OP_END; op++) {
+        const char *name = opcodes[op].name;
+        if (strlen(name) != len)
+            continue;
+        size_t i = 0;
+        while (i < len && toupper((unsigned char)tok[i]) == name[i])
+            i++;
+        if (i == len)
+            return (Opcode)op;
+    }
+    return OP_END;
+}
+
+static void define_label(VM *vm, int label, int at)
+{
+    if (label >= vm->label_cap) {
+        int old = vm->label_cap;
+        vm->label_at = grow(vm->label_at, &vm->label_cap, label + 1, sizeof(int));
+        for (int i = old; i < vm->label_cap; i++)
+            vm->label_at[i] = -1;
+    }
+    vm->label_at[label] = at;
+}
+
+static Instr *append(VM *vm, Opcode op, int line)
+{
+    vm->code = grow(vm->code, &vm->cap, vm->count + 1, sizeof(Instr));
+    Instr *in = &vm->code[vm->count++];
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    in->line = line;
+    in->target = -1;
+    return in;
+}
+
+// 0 when the program is well formed, else the exit code
+static int load(VM *vm, const char *code, size_t len)
+{
+    bool header = false;
+    int line = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        size_t eol = pos;
+        while (eol < len && code[eol] != '\n')
+            eol++;
+        line++;
+
+        // tokens up to a comment
+        const char *tok[5];
+        size_t tok_len[5];
+        int n = 0;
+        size_t i = pos;
+        while (i < eol && code[i] != '#') {
+            if (isspace((unsigned char)code[i])) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < eol && code[i] != '#' && !isspace((unsigned char)code[i]))
+                i++;
+            if (n == 5)
+                return load_error(line, "too many operands");
+            tok[n] = code + start;
+            tok_len[n++] = i - start;
+        }
+        pos = eol + 1;
+        if (n == 0)
+            continue;
+
+        if (!header) {
+            if (n != 1 || tok_len[0] != 10)
+                return load_error(line, "missing header");
+            char h[11];
+            for (int k = 0; k < 10; k++)
+                h[k] = (char)toupper((unsigned char)tok[0][k]);
+            h[10] = '\0';
+            if (strcmp(h, ".IFJCODE25") != 0)
+                return load_error(line, "missing header");
+            header = true;
+            continue;
+        }
+
+        Opcode op = find_opcode(tok[0], tok_len[0]);
+        if (op == OP_END)
+            return load_error(line, "unknown instruction");
+        const char *kinds = opcodes[op].operands;
+        if ((int)strlen(kinds) != n - 1)
+            return load_error(line, "wrong number of operands");
+
+        Operand ops[3] = { 0 };
+        for (int k = 0; k < n - 1; k++)
+            if (!parse_operand(vm, kinds[k], tok[k + 1], tok_len[k + 1], &ops[k]))
+                return load_error(line, "bad operand");
+
+        if (op == OP_LABEL) {
+            if (ops[0].index < vm->label_cap && vm->label_at[ops[0].index] >= 0) {
+                fprintf(stderr, "Label already exists!\n");
+                return VM_ERR_SEM;
+            }
+            define_label(vm, ops[0].index, vm->count);
+            continue;
+        }
+
+        Instr *in = append(vm, op, line);
+        if (kinds[0] == 'l') {
+            in->target = ops[0].index;      // label id for now
+            in->b = ops[1];
+            in->c = ops[2];
+        } else {
+            in->a = ops[0];
+            in->b = ops[1];
+            in->c = ops[2];
+        }
+    }
+
+    if (!header)
+        return load_error(line, "missing header");
+    append(vm, OP_END, line);
+
+    // label ids → instruction indices
+    for (int i = 0; i < vm->count; i++) {
+        Instr *in = &vm->code[i];
+        if (opcodes[in->op].operands[0] == 'l') {
+            int label = in->target;
+            in->target = label < vm->label_cap ? vm->label_at[label] : -1;
+        }
+    }
+    return 0;
+}
+
+static void unload(VM *vm)
+{
+    for (int i = 0; i < vm->count; i++) {
+        value_release(&vm->code[i].a.value);
+        value_release(&vm->code[i].b.value);
+        value_release(&vm->code[i].c.value);
+    }
+    free(vm->code);
+
+    frame_clear(&vm->gf);
+    free(vm->gf.slots);
+    frame_drop(vm, vm->tf);
+    while (vm->lf_count > 0)
+        frame_drop(vm, vm->lf[--vm->lf_count]);
+    for (int i = 0; i < vm->pool_count; i++) {
+        free(vm->pool[i]->slots);
+        free(vm->pool[i]);
+    }
+    free(vm->pool);
+    free(vm->lf);
+
+    for (int i = 0; i < vm->sp; i++)
+        value_release(&vm->stack[i]);
+    free(vm->stack);
+    free(vm->calls);
+
+    free(vm->globals.ids);
+    free(vm->locals.ids);
+    free(vm->labels.ids);
+    free(vm->label_at);
+    free(vm->line);
+}
+
+/* ---------------------------------------------------------
+   Run-time helpers
+   A run-time error ends the process the way ic25int does,
+   after flushing what the program wrote so far.
+   --------------------------------------------------------- */
+
+#define VM_ERR_TYPE    53
+#define VM_ERR_UNDEF   54
+#define VM_ERR_FRAME   55
+#define VM_ERR_MISSING 56
+#define VM_ERR_VALUE   57
+#define VM_ERR_STRING  58
+
+static void fail(const Instr *pc, int code, const char *msg)
+{
+    fflush(stdout);
+    error_exit(code, "Error at line: %d\n%s\n", pc->line, msg);
+}
+
+static Value *var(VM *vm, const Instr *pc, const Operand *o)
+{
+    Frame *f;
+    if (o->kind == A_GF)
+        f = &vm->gf;
+    else if (o->kind == A_LF) {
+        if (vm->lf_count == 0)
+            fail(pc, VM_ERR_FRAME, "Local frame does not exist!");
+        f = vm->lf[vm->lf_count - 1];
+    } else {
+        if (!vm->tf)
+            fail(pc, VM_ERR_FRAME, "Temporary frame does not exist!");
+        f = vm->tf;
+    }
+    if (o->index >= f->cap || f->slots[o->index].type == V_UNDEF)
+        fail(pc, VM_ERR_UNDEF, "Symbol is undefined!");
+    return &f->slots[o->index];
+}
+
+static const Value *symb(VM *vm, const Instr *pc, const Operand *o)
+{
+    if (o->kind == A_CONST)
+        return &o->value;
+    const Value *v = var(vm, pc, o);
+    if (v->type == V_UNINIT)
+        fail(pc, VM_ERR_MISSING, "Symbol has not been initilized!");
+    return v;
+}
+
+static void push(VM *vm, const Value *v)
+{
+    vm->stack = grow(vm->stack, &vm->stack_cap, vm->sp + 1, sizeof(Value));
+    vm->stack[vm->sp] = (Value){ .type = V_NIL };
+    value_copy(&vm->stack[vm->sp++], v);
+}
+
+static void push_value(VM *vm, Value v)
+{
+    vm->stack = grow(vm->stack, &vm->stack_cap, vm->sp + 1, sizeof(Value));
+    vm->stack[vm->sp++] = v;
+}
+
+// the popped value belongs to the caller
+static Value pop(VM *vm, const Instr *pc)
+{
+    if (vm->sp == 0)
+        fail(pc, VM_ERR_MISSING, "Operand stack is empty");
+    return vm->stack[--vm->sp];
+}
+
+static bool same_type(const Value *x, const Value *y, ValueType type)
+{
+    return x->type == type && y->type == type;
+}
+
+static Value arith(const Instr *pc, Opcode op, const Value *x, const Value *y)
+{
+    if (same_type(x, y, V_INT)) {
+        // two's complement wrap-around, like ic25int
+        unsigned long long a = (unsigned long long)x->u.i, b = (unsigned long long)y->u.i;
+        switch (op) {
+            case OP_ADD: return make_int((long long)(a + b));
+            case OP_SUB: return make_int((long long)(a - b));
+            case OP_MUL: return make_int((long long)(a * b));
+            case OP_IDIV: {
+                if (y->u.i == 0)
+                    fail(pc, VM_ERR_VALUE, "Division by zero!");
+                if (y->u.i == -1)
+                    return make_int((long long)(0 - a));
+                long long q = x->u.i / y->u.i;
+                if (x->u.i % y->u.i != 0 && (x->u.i < 0) != (y->u.i < 0))
+                    q--;    // rounds towards negative infinity
+                return make_int(q);
+            }
+            default:
+                break;
+        }
+    } else if (same_type(x, y, V_FLOAT)) {
+        switch (op) {
+            case OP_ADD: return make_float(x->u.f + y->u.f);
+            case OP_SUB: return make_float(x->u.f - y->u.f);
+            case OP_MUL: return make_float(x->u.f * y->u.f);
+            case OP_DIV:
+                if (y->u.f == 0.0)
+                    fail(pc, VM_ERR_VALUE, "Division by zero!");
+                return make_float(x->u.f / y->u.f);
+            default:
+                break;
+        }
+    }
+    fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+    return make_nil();
+}
+
+// <0, 0, >0 like strcmp; nil only compares equal to nil
+static int compare(const Instr *pc, const Value *x, const Value *y)
+{
+    if (x->type != y->type)
+        fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+    switch (x->type) {
+        case V_INT:    return (x->u.i > y->u.i) - (x->u.i < y->u.i);
+        case V_FLOAT:  return (x->u.f > y->u.f) - (x->u.f < y->u.f);
+        case V_BOOL:   return (int)x->u.b - (int)y->u.b;
+        case V_STRING: {
+            size_t n = x->u.s->len < y->u.s->len ? x->u.s->len : y->u.s->len;
+            int c = memcmp(x->u.s->data, y->u.s->data, n);
+            if (c)
+                return c;
+            return (x->u.s->len > y->u.s->len) - (x->u.s->len < y->u.s->len);
+        }
+        default:
+            fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+            return 0;
+    }
+}
+
+static bool equal(const Instr *pc, const Value *x, const Value *y)
+{
+    if (x->type == V_NIL || y->type == V_NIL)
+        return x->type == y->type;
+    if (x->type == V_FLOAT && y->type == V_FLOAT)
+        return x->u.f == y->u.f;    // NaN is not equal to itself
+    return compare(pc, x, y) == 0;
+}
+
+static Value relation(const Instr *pc, Opcode op, const Value *x, const Value *y)
+{
+    switch (op) {
+        case OP_EQ: return make_bool(equal(pc, x, y));
+        case OP_LT:
+            if (x->type == V_FLOAT && y->type == V_FLOAT)
+                return make_bool(x->u.f < y->u.f);
+            return make_bool(compare(pc, x, y) < 0);
+        default:
+            if (x->type == V_FLOAT && y->type == V_FLOAT)
+                return make_bool(x->u.f > y->u.f);
+            return make_bool(compare(pc, x, y) > 0);
+    }
+}
+
+static Value logic(const Instr *pc, Opcode op, const Value *x, const Value *y)
+{
+    if (x->type != V_BOOL || (y && y->type != V_BOOL))
+        fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+    switch (op) {
+        case OP_AND: return make_bool(x->u.b && y->u.b);
+        case OP_OR:  return make_bool(x->u.b || y->u.b);
+        default:     return make_bool(!x->u.b);
+    }
+}
+
+static Value convert(const Instr *pc, Opcode op, const Value *x)
+{
+    char buf[512];
+
+    switch (op) {
+        case OP_INT2FLOAT:
+            if (x->type == V_INT)
+                return make_float((double)x->u.i);
+            break;
+        case OP_FLOAT2INT:
+            if (x->type == V_FLOAT) {
+                double f = x->u.f;
+                // out of range (and NaN) gives what the x86 conversion does
+                if (!(f >= -0x1p63 && f < 0x1p63))
+                    return make_int((long long)(-0x7fffffffffffffffLL - 1));
+                return make_int((long long)f);
+            }
+            break;
+        case OP_INT2CHAR:
+            if (x->type == V_INT) {
+                if (x->u.i < 0 || x->u.i > 255)
+                    fail(pc, VM_ERR_STRING, "Escape sequence not in the 0-255 range!");
+                char c = (char)x->u.i;
+                return make_string(&c, 1);
+            }
+            break;
+        case OP_INT2STR:
+            if (x->type == V_INT) {
+                int n = snprintf(buf, sizeof(buf), "%lld", x->u.i);
+                return make_string(buf, (size_t)n);
+            }
+            break;
+        case OP_FLOAT2STR:
+            if (x->type == V_FLOAT) {
+                int n = snprintf(NULL, 0, "%.2f", x->u.f);
+                char *big = malloc((size_t)n + 1);
+                if (!big)
+                    error_exit(99, "Out of memory (vm)\n");
+                snprintf(big, (size_t)n + 1, "%.2f", x->u.f);
+                Value v = make_string(big, (size_t)n);
+                free(big);
+                return v;
+            }
+            break;
+        case OP_ISINT:
+            if (x->type == V_INT)
+                return make_bool(true);
+            if (x->type == V_FLOAT) {
+                double f = x->u.f;
+                if (f != f)
+                    return make_bool(false);
+                // every float this large is integral, infinities included
+                if (f >= 0x1p52 || f <= -0x1p52)
+                    return make_bool(true);
+                return make_bool((double)(long long)f == f);
+            }
+            break;
+        default:
+            break;
+    }
+    fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+    return make_nil();
+}
+
+static long long string_index(const Instr *pc, const Value *s, const Value *i)
+{
+    if (s->type != V_STRING || i->type != V_INT)
+        fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+    if (i->u.i < 0 || (unsigned long long)i->u.i >= s->u.s->len)
+        fail(pc, VM_ERR_STRING, "String index out of bounds!");
+    return i->u.i;
+}
+
+static Value stri2int(const Instr *pc, const Value *s, const Value *i)
+{
+    long long at = string_index(pc, s, i);
+    return make_int((unsigned char)s->u.s->data[at]);
+}
+
+static void write_value(FILE *out, const Value *v)
+{
+    switch (v->type) {
+        case V_INT:    fprintf(out, "%lld", v->u.i); break;
+        case V_FLOAT:  fprintf(out, "%a", v->u.f); break;
+        case V_BOOL:   fputs(v->u.b ? "true" : "false", out); break;
+        case V_NIL:    fputs("null", out); break;
+        case V_STRING: fwrite(v->u.s->data, 1, v->u.s->len, out); break;
+        default:       break;
+    }
+}
+
+// one line of stdin without its '\n'; false at end of input
+static bool read_line(VM *vm, size_t *len)
+{
+    int c;
+    *len = 0;
+    while ((c = getchar()) != EOF && c != '\n') {
+        vm->line = grow(vm->line, &vm->line_cap, (int)*len + 2, 1);
+        vm->line[(*len)++] = (char)c;
+    }
+    vm->line = grow(vm->line, &vm->line_cap, (int)*len + 1, 1);
+    vm->line[*len] = '\0';
+    return c != EOF || *len > 0;
+}
+
+// READ: a value of `type`, nil when the line does not hold one
+static Value read_value(VM *vm, ValueType type)
+{
+    size_t len;
+    if (!read_line(vm, &len))
+        return make_nil();
+
+    const char *s = vm->line;
+    const char *digits = (s[0] == '+' || s[0] == '-') ? s + 1 : s;
+    char *end;
+
+    switch (type) {
+        case V_STRING:
+            return make_string(s, len);
+        case V_INT: {
+            if (!isdigit((unsigned char)*digits))
+                break;
+            long long i = strtoll(s, &end, 0);
+            if (*end == '\0')
+                return make_int(i);
+            break;
+        }
+        case V_FLOAT: {
+            if (!isdigit((unsigned char)*digits) && *digits != '.')
+                break;
+            double f = strtod(s, &end);
+            if (*end == '\0')
+                return make_float(f);
+            break;
+        }
+        case V_BOOL:
+            if (strcmp(s, "true") == 0 || strcmp(s, "false") == 0)
+                return make_bool(s[0] == 't');
+            break;
+        default:
+            break;
+    }
+    return make_nil();
+}
+
+static const char *type_name(ValueType t)
+{
+    switch (t) {
+        case V_INT:    return "int";
+        case V_FLOAT:  return "float";
+        case V_BOOL:   return "bool";
+        case V_NIL:    return "nil";
+        case V_STRING: return "string";
+        default:       return "";
+    }
+}
+
+/* ---------------------------------------------------------
+   Dispatch loop
+   Each handler ends by jumping straight to the next one
+   through the address stored in the instruction (threaded
+   code); without computed goto it falls back to a switch.
+   --------------------------------------------------------- */
+
+#ifdef VM_THREADED
+#define TARGET(op)   L_##op:
+#define DISPATCH()   goto *pc->handler
+#else
+#define TARGET(op)   case op:
+#define DISPATCH()   goto dispatch
+#endif
+
+#define NEXT()       do { pc++; DISPATCH(); } while (0)
+#define JUMP_TO(t)   do { int to_ = (t); \
+                          if (to_ < 0) fail(pc, VM_ERR_SEM, "Label does not exist!"); \
+                          pc = vm->code + to_; DISPATCH(); } while (0)
+#define DST          var(vm, pc, &pc->a)
+#define ARG1         symb(vm, pc, &pc->b)
+#define ARG2         symb(vm, pc, &pc->c)
+
+static int execute(VM *vm)
+{
+    const Instr *pc = vm->code;
+    Value x, y;
+
+#ifdef VM_THREADED
+    static const void *const handlers[OP_COUNT] = {
+        [OP_MOVE] = &&L_OP_MOVE, [OP_CREATEFRAME] = &&L_OP_CREATEFRAME,
+        [OP_PUSHFRAME] = &&L_OP_PUSHFRAME, [OP_POPFRAME] = &&L_OP_POPFRAME,
+        [OP_DEFVAR] = &&L_OP_DEFVAR, [OP_CALL] = &&L_OP_CALL, [OP_RETURN] = &&L_OP_RETURN,
+        [OP_PUSHS] = &&L_OP_PUSHS, [OP_POPS] = &&L_OP_POPS, [OP_CLEARS] = &&L_OP_CLEARS,
+        [OP_ADD] = &&L_OP_ADD, [OP_SUB] = &&L_OP_SUB, [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV, [OP_IDIV] = &&L_OP_IDIV,
+        [OP_ADDS] = &&L_OP_ADDS, [OP_SUBS] = &&L_OP_SUBS, [OP_MULS] = &&L_OP_MULS,
+        [OP_DIVS] = &&L_OP_DIVS, [OP_IDIVS] = &&L_OP_IDIVS,
+        [OP_LT] = &&L_OP_LT, [OP_GT] = &&L_OP_GT, [OP_EQ] = &&L_OP_EQ,
+        [OP_LTS] = &&L_OP_LTS, [OP_GTS] = &&L_OP_GTS, [OP_EQS] = &&L_OP_EQS,
+        [OP_AND] = &&L_OP_AND, [OP_OR] = &&L_OP_OR, [OP_NOT] = &&L_OP_NOT,
+        [OP_ANDS] = &&L_OP_ANDS, [OP_ORS] = &&L_OP_ORS, [OP_NOTS] = &&L_OP_NOTS,
+        [OP_INT2FLOAT] = &&L_OP_INT2FLOAT, [OP_FLOAT2INT] = &&L_OP_FLOAT2INT,
+        [OP_INT2CHAR] = &&L_OP_INT2CHAR, [OP_STRI2INT] = &&L_OP_STRI2INT,
+        [OP_INT2FLOATS] = &&L_OP_INT2FLOATS, [OP_FLOAT2INTS] = &&L_OP_FLOAT2INTS,
+        [OP_INT2CHARS] = &&L_OP_INT2CHARS, [OP_STRI2INTS] = &&L_OP_STRI2INTS,
+        [OP_INT2STR] = &&L_OP_INT2STR, [OP_FLOAT2STR] = &&L_OP_FLOAT2STR,
+        [OP_ISINT] = &&L_OP_ISINT,
+        [OP_READ] = &&L_OP_READ, [OP_WRITE] = &&L_OP_WRITE,
+        [OP_CONCAT] = &&L_OP_CONCAT, [OP_STRLEN] = &&L_OP_STRLEN,
+        [OP_GETCHAR] = &&L_OP_GETCHAR, [OP_SETCHAR] = &&L_OP_SETCHAR,
+        [OP_TYPE] = &&L_OP_TYPE,
+        [OP_LABEL] = &&L_OP_END, [OP_JUMP] = &&L_OP_JUMP,
+        [OP_JUMPIFEQ] = &&L_OP_JUMPIFEQ, [OP_JUMPIFNEQ] = &&L_OP_JUMPIFNEQ,
+        [OP_JUMPIFEQS] = &&L_OP_JUMPIFEQS, [OP_JUMPIFNEQS] = &&L_OP_JUMPIFNEQS,
+        [OP_EXIT] = &&L_OP_EXIT, [OP_BREAK] = &&L_OP_BREAK, [OP_DPRINT] = &&L_OP_DPRINT,
+        [OP_END] = &&L_OP_END,
+    };
+    for (int i = 0; i < vm->count; i++)
+        vm->code[i].handler = handlers[vm->code[i].op];
+    DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+
+    TARGET(OP_MOVE)
+        value_copy(DST, ARG1);
+        NEXT();
+
+    TARGET(OP_CREATEFRAME)
+        frame_drop(vm, vm->tf);
+        vm->tf = frame_new(vm);
+        NEXT();
+
+    TARGET(OP_PUSHFRAME)
+        if (!vm->tf)
+            fail(pc, VM_ERR_FRAME, "Temporary frame does not exist!");
+        vm->lf = grow(vm->lf, &vm->lf_cap, vm->lf_count + 1, sizeof(Frame *));
+        vm->lf[vm->lf_count++] = vm->tf;
+        vm->tf = NULL;
+        NEXT();
+
+    TARGET(OP_POPFRAME)
+        if (vm->lf_count == 0)
+            fail(pc, VM_ERR_FRAME, "Local frame does not exist!");
+        frame_drop(vm, vm->tf);
+        vm->tf = vm->lf[--vm->lf_count];
+        NEXT();
+
+    TARGET(OP_DEFVAR) {
+        Frame *f = pc->a.kind == A_GF ? &vm->gf :
+                   pc->a.kind == A_LF ? (vm->lf_count ? vm->lf[vm->lf_count - 1] : NULL) :
+                   vm->tf;
+        if (!f)
+            fail(pc, VM_ERR_FRAME, "Frame does not exist!");
+        if (pc->a.index >= f->cap)
+            frame_reserve(f, pc->a.index + 1);
+        if (f->slots[pc->a.index].type != V_UNDEF)
+            fail(pc, VM_ERR_SEM, "Symbol already exists!");
+        f->slots[pc->a.index].type = V_UNINIT;
+        NEXT();
+    }
+
+    TARGET(OP_CALL)
+        vm->calls = grow(vm->calls, &vm->call_cap, vm->call_count + 1, sizeof(int));
+        vm->calls[vm->call_count++] = (int)(pc - vm->code) + 1;
+        JUMP_TO(pc->target);
+
+    TARGET(OP_RETURN)
+        if (vm->call_count == 0)
+            fail(pc, VM_ERR_MISSING, "Call stack is empty!");
+        JUMP_TO(vm->calls[--vm->call_count]);
+
+    TARGET(OP_PUSHS)
+        push(vm, symb(vm, pc, &pc->a));
+        NEXT();
+
+    TARGET(OP_POPS) {
+        Value *dst = DST;
+        value_take(dst, pop(vm, pc));
+        NEXT();
+    }
+
+    TARGET(OP_CLEARS)
+        while (vm->sp > 0)
+            value_release(&vm->stack[--vm->sp]);
+        NEXT();
+
+    TARGET(OP_ADD)
+    TARGET(OP_SUB)
+    TARGET(OP_MUL)
+    TARGET(OP_DIV)
+    TARGET(OP_IDIV) {
+        Value *dst = DST;
+        value_take(dst, arith(pc, pc->op, ARG1, ARG2));
+        NEXT();
+    }
+
+    TARGET(OP_ADDS)
+    TARGET(OP_SUBS)
+    TARGET(OP_MULS)
+    TARGET(OP_DIVS)
+    TARGET(OP_IDIVS)
+        y = pop(vm, pc);
+        x = pop(vm, pc);
+        push_value(vm, arith(pc, pc->op - OP_ADDS + OP_ADD, &x, &y));
+        value_release(&x);
+        value_release(&y);
+        NEXT();
+
+    TARGET(OP_LT)
+    TARGET(OP_GT)
+    TARGET(OP_EQ) {
+        Value *dst = DST;
+        value_take(dst, relation(pc, pc->op, ARG1, ARG2));
+        NEXT();
+    }
+
+    TARGET(OP_LTS)
+    TARGET(OP_GTS)
+    TARGET(OP_EQS)
+        y = pop(vm, pc);
+        x = pop(vm, pc);
+        push_value(vm, relation(pc, pc->op - OP_LTS + OP_LT, &x, &y));
+        value_release(&x);
+        value_release(&y);
+        NEXT();
+
+    TARGET(OP_AND)
+    TARGET(OP_OR) {
+        Value *dst = DST;
+        value_take(dst, logic(pc, pc->op, ARG1, ARG2));
+        NEXT();
+    }
+
+    TARGET(OP_NOT) {
+        Value *dst = DST;
+        value_take(dst, logic(pc, OP_NOT, ARG1, NULL));
+        NEXT();
+    }
+
+    TARGET(OP_ANDS)
+    TARGET(OP_ORS)
+        y = pop(vm, pc);
+        x = pop(vm, pc);
+        push_value(vm, logic(pc, pc->op - OP_ANDS + OP_AND, &x, &y));
+        value_release(&x);
+        value_release(&y);
+        NEXT();
+
+    TARGET(OP_NOTS)
+        x = pop(vm, pc);
+        push_value(vm, logic(pc, OP_NOT, &x, NULL));
+        value_release(&x);
+        NEXT();
+
+    TARGET(OP_INT2FLOAT)
+    TARGET(OP_FLOAT2INT)
+    TARGET(OP_INT2CHAR)
+    TARGET(OP_INT2STR)
+    TARGET(OP_FLOAT2STR)
+    TARGET(OP_ISINT) {
+        Value *dst = DST;
+        value_take(dst, convert(pc, pc->op, ARG1));
+        NEXT();
+    }
+
+    TARGET(OP_INT2FLOATS)
+    TARGET(OP_FLOAT2INTS)
+    TARGET(OP_INT2CHARS)
+        x = pop(vm, pc);
+        push_value(vm, convert(pc, pc->op - OP_INT2FLOATS + OP_INT2FLOAT, &x));
+        value_release(&x);
+        NEXT();
+
+    TARGET(OP_STRI2INT) {
+        Value *dst = DST;
+        value_take(dst, stri2int(pc, ARG1, ARG2));
+        NEXT();
+    }
+
+    TARGET(OP_STRI2INTS)
+        y = pop(vm, pc);
+        x = pop(vm, pc);
+        push_value(vm, stri2int(pc, &x, &y));
+        value_release(&x);
+        value_release(&y);
+        NEXT();
+
+    TARGET(OP_READ) {
+        Value *dst = DST;
+        value_take(dst, read_value(vm, (ValueType)pc->b.index));
+        NEXT();
+    }
+
+    TARGET(OP_WRITE)
+        write_value(stdout, symb(vm, pc, &pc->a));
+        NEXT();
+
+    TARGET(OP_CONCAT) {
+        Value *dst = DST;
+        const Value *a = ARG1, *b = ARG2;
+        if (!same_type(a, b, V_STRING))
+            fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+        VMString *s = malloc(sizeof(VMString) + a->u.s->len + b->u.s->len + 1);
+        if (!s)
+            error_exit(99, "Out of memory (vm string)\n");
+        s->refs = 1;
+        s->len = a->u.s->len + b->u.s->len;
+        memcpy(s->data, a->u.s->data, a->u.s->len);
+        memcpy(s->data + a->u.s->len, b->u.s->data, b->u.s->len);
+        s->data[s->len] = '\0';
+        value_take(dst, (Value){ .type = V_STRING, .u.s = s });
+        NEXT();
+    }
+
+    TARGET(OP_STRLEN) {
+        Value *dst = DST;
+        const Value *a = ARG1;
+        if (a->type != V_STRING)
+            fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+        value_take(dst, make_int((long long)a->u.s->len));
+        NEXT();
+    }
+
+    TARGET(OP_GETCHAR) {
+        Value *dst = DST;
+        const Value *s = ARG1;
+        long long at = string_index(pc, s, ARG2);
+        value_take(dst, make_string(&s->u.s->data[at], 1));
+        NEXT();
+    }
+
+    TARGET(OP_SETCHAR) {
+        Value *dst = DST;
+        if (dst->type == V_UNINIT)
+            fail(pc, VM_ERR_MISSING, "Symbol has not been initilized!");
+        const Value *with = ARG2;
+        long long at = string_index(pc, dst, ARG1);
+        if (with->type != V_STRING)
+            fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+        if (with->u.s->len == 0)
+            fail(pc, VM_ERR_STRING, "Using empty string as an substitution!");
+        char c = with->u.s->data[0];
+        if (dst->u.s->refs > 1)
+            value_take(dst, make_string(dst->u.s->data, dst->u.s->len));
+        dst->u.s->data[at] = c;
+        NEXT();
+    }
+
+    TARGET(OP_TYPE) {
+        Value *dst = DST;
+        const Value *a = pc->b.kind == A_CONST ? &pc->b.value : var(vm, pc, &pc->b);
+        const char *name = type_name(a->type);
+        value_take(dst, make_string(name, strlen(name)));
+        NEXT();
+    }
+
+    TARGET(OP_JUMP)
+        JUMP_TO(pc->target);
+
+    TARGET(OP_JUMPIFEQ)
+        if (equal(pc, ARG1, ARG2))
+            JUMP_TO(pc->target);
+        NEXT();
+
+    TARGET(OP_JUMPIFNEQ)
+        if (!equal(pc, ARG1, ARG2))
+            JUMP_TO(pc->target);
+        NEXT();
+
+    TARGET(OP_JUMPIFEQS)
+    TARGET(OP_JUMPIFNEQS) {
+        y = pop(vm, pc);
+        x = pop(vm, pc);
+        bool eq = equal(pc, &x, &y);
+        value_release(&x);
+        value_release(&y);
+        if (eq == (pc->op == OP_JUMPIFEQS))
+            JUMP_TO(pc->target);
+        NEXT();
+    }
+
+    TARGET(OP_EXIT) {
+        const Value *code = symb(vm, pc, &pc->a);
+        if (code->type != V_INT)
+            fail(pc, VM_ERR_TYPE, "Wrong operand type!");
+        if (code->u.i < 0 || code->u.i > 49) {
+            fflush(stdout);
+            error_exit(VM_ERR_VALUE, "EXIT instruction expects values in the range 0-49!\n");
+        }
+        return (int)code->u.i;
+    }
+
+    TARGET(OP_BREAK)
+        fprintf(stderr, "Current line: %d\n", pc->line);
+        NEXT();
+
+    TARGET(OP_DPRINT)
+        write_value(stderr, symb(vm, pc, &pc->a));
+        NEXT();
+
+    TARGET(OP_END)
+        return 0;
+
+#ifndef VM_THREADED
+        default:
+            return 0;
+    }
+#endif
+}
+
+int vm_run(const char *code, size_t len)
+{
+    VM vm = { 0 };
+
+    int rc = load(&vm, code, len);
+    if (rc == 0) {
+        frame_reserve(&vm.gf, vm.globals.count);
+        rc = execute(&vm);
+    }
+    fflush(stdout);
+
+    unload(&vm);
+    return rc;
+}
@@ -0,0 +1,20 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stddef.h>
+
+/* ---------------------------------------------------------
+   IFJcode25 virtual machine
+   Runs generated code in-process instead of through ic25int.
+   The text is parsed once into an instruction array with
+   labels resolved to indices and variables to frame slots,
+   then run by a threaded dispatch loop.
+   --------------------------------------------------------- */
+
+/// Run `len` bytes of IFJcode25 with stdin/stdout as the program's I/O.
+/// Returns the exit code ic25int would: the EXIT operand, 0 when the
+/// program ends, 51/52 for bad code and 53-58 for run-time errors
+/// (those are reported on stderr).
+int vm_run(const char *code, size_t len);
+
+#endif